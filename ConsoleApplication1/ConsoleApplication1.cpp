@@ -11,6 +11,7 @@
 //#include "gui_window_help.h"
 
 #include <fstream>
+#include <algorithm>
 
 enum class type {
     AND,
@@ -102,7 +103,14 @@ int main()
 
     double expected_updates = 0.0;
     double pre_update_t = 0;
-    RollingAverage roller(60);
+    // ticks and seconds of the last frames, their ratio is the achieved rate even when frame lengths vary
+    RollingAverage roller_ticks(60);
+    RollingAverage roller_time(60);
+
+    // warp yields to the renderer just often enough to hold this frame rate
+    double warp_min_fps = 30;
+    double tick_cost = 0;
+    double draw_time = 0;
 
     SetTargetFPS(draw_frequency);
 
@@ -114,34 +122,65 @@ int main()
         size_t i = 0;
         double duration;
         double elapsed_time = 0;
-        if (expected_updates >= 1.0) {
-            t = GetTime();
-            game.pretick();
-            game.tick();
-            i++;
-            expected_updates--;
-            duration = GetTime() - t;
-            elapsed_time += duration;
+        uint64_t thread_ticks;
+        if (game.update_sim_thread(thread_ticks)) {
+            // the simulation thread keeps its own pace
+            i = thread_ticks;
+            expected_updates = 0;
+        }
+        else if (game.warp) {
+            // fill the frame with ticks, every batch takes about half the remaining budget at the
+            // measured tick cost so the clock is only read a handful of times per frame
+            const double budget = std::max(1.0 / warp_min_fps - draw_time, 0.001);
+            const double start = GetTime();
+            double now = start;
+            while (now - start < budget) {
+                size_t batch = tick_cost > 0 ? size_t((budget - (now - start)) / tick_cost / 2) : 1;
+                batch = std::max<size_t>(batch, 1);
+                for (size_t b = 0; b < batch; b++) {
+                    game.pretick();
+                    game.tick();
+                }
+                double after = GetTime();
+                tick_cost = (after - now) / batch;
+                i += batch;
+                now = after;
+            }
+            expected_updates = 0;
         }
-        while (expected_updates >= 1.0 && elapsed_time < 1.0f / draw_frequency) {
-            game.pretick();
-            game.tick();
-            expected_updates--;
-            i++;
-            elapsed_time += duration;
+        else {
+            if (expected_updates >= 1.0) {
+                t = GetTime();
+                game.pretick();
+                game.tick();
+                i++;
+                expected_updates--;
+                duration = GetTime() - t;
+                elapsed_time += duration;
+            }
+            while (expected_updates >= 1.0 && elapsed_time < 1.0f / draw_frequency) {
+                game.pretick();
+                game.tick();
+                expected_updates--;
+                i++;
+                elapsed_time += duration;
+            }
         }
 
 
+        double draw_t = GetTime();
         game.draw();
 
         t = GetTime();
+        draw_time = t - draw_t;
         expected_updates += (t - pre_update_t) * game.targ_sim_hz;
-        if (expected_updates > game.targ_sim_hz * 5)
+        if (!game.warp && expected_updates > game.targ_sim_hz * 5)
             expected_updates = game.targ_sim_hz * 5;
 
-        roller.add(i / (t - pre_update_t));
+        roller_ticks.add(double(i));
+        roller_time.add(t - pre_update_t);
            
-        game.real_sim_hz = roller.getAverage();
+        game.real_sim_hz = roller_ticks.getAverage() / roller_time.getAverage();
         i = 0;
 
     }
@@ -0,0 +1,94 @@
+#include "activity_stats.h"
+
+#include "main_game.h"
+
+#include <bit>
+#include <algorithm>
+
+// adds delta to counts[i] for every set bit i of bits
+static void count_bits(uint64_t bits, uint32_t* counts, int delta)
+{
+    while (bits) {
+        counts[std::countr_zero(bits)] += delta;
+        bits &= bits - 1;
+    }
+}
+
+void ActivityStats::reset(size_t count, std::vector<std::pair<const Output_connector*, uint32_t>> connectors)
+{
+    signal_count = count;
+    words_per_sample = (count + 63) / 64;
+    last_word_mask = count % 64 ? (uint64_t(1) << (count % 64)) - 1 : ~uint64_t(0);
+    samples = 0;
+    slots = std::max<size_t>(window, 1) + 1;
+
+    ring.assign(slots * words_per_sample, 0);
+    toggle_counts.assign(count, 0);
+    high_counts.assign(count, 0);
+    window_toggle_total = 0;
+    total_toggles = 0;
+    total_ticks = 0;
+    connector_signals = std::move(connectors);
+}
+
+void ActivityStats::sample(const uint64_t* words)
+{
+    // tick k of the window is sample k against sample k - 1, sample 0 is only the starting state
+    const size_t k = samples;
+    uint64_t* slot = ring.data() + (k % slots) * words_per_sample;
+
+    if (k >= slots) {
+        // the slot holds sample k - slots, the previous state of the tick that leaves the window
+        const uint64_t* leaving = ring.data() + ((k + 1) % slots) * words_per_sample;
+        for (size_t w = 0; w < words_per_sample; w++) {
+            uint64_t diff = slot[w] ^ leaving[w];
+            window_toggle_total -= std::popcount(diff);
+            count_bits(diff, toggle_counts.data() + w * 64, -1);
+            count_bits(leaving[w], high_counts.data() + w * 64, -1);
+        }
+    }
+
+    if (k > 0) {
+        const uint64_t* previous = ring.data() + ((k + slots - 1) % slots) * words_per_sample;
+        for (size_t w = 0; w < words_per_sample; w++) {
+            uint64_t word = w + 1 == words_per_sample ? words[w] & last_word_mask : words[w];
+            uint64_t diff = word ^ previous[w];
+            uint64_t flips = std::popcount(diff);
+            window_toggle_total += flips;
+            total_toggles += flips;
+            count_bits(diff, toggle_counts.data() + w * 64, 1);
+            count_bits(word, high_counts.data() + w * 64, 1);
+        }
+        total_ticks++;
+    }
+
+    std::copy(words, words + words_per_sample, slot);
+    if (words_per_sample) slot[words_per_sample - 1] &= last_word_mask;
+    samples++;
+}
+
+size_t ActivityStats::window_ticks() const
+{
+    return samples == 0 ? 0 : std::min(samples - 1, slots - 1);
+}
+
+float ActivityStats::duty_cycle(uint32_t signal) const
+{
+    size_t ticks = window_ticks();
+    return ticks ? float(high_counts[signal]) / float(ticks) : 0.0f;
+}
+
+double ActivityStats::toggle_rate() const
+{
+    size_t ticks = window_ticks();
+    return ticks && signal_count ? double(window_toggle_total) / double(ticks) / double(signal_count) : 0.0;
+}
+
+std::unordered_map<const Node*, uint64_t> ActivityStats::toggles_by_node() const
+{
+    std::unordered_map<const Node*, uint64_t> nodes;
+    for (auto& [conn, signal] : connector_signals) {
+        nodes[conn->host] += toggle_counts[signal];
+    }
+    return nodes;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+struct Node;
+struct Output_connector;
+
+// Toggle counts and duty cycle of every signal over the last window ticks. A tick is sampled as
+// state words packed like SignalStore, its toggles are the XOR with the previous sample, so a
+// sample costs a pass over the words plus work per toggling or high bit instead of a branch per
+// signal. The samples of the window are kept to take the oldest tick back out.
+class ActivityStats {
+public:
+    bool enabled = false;
+    // ticks in the window, takes effect on the next reset
+    size_t window = 256;
+
+    // Starts over with signal_count signals. connectors are the editor connectors to attribute
+    // the signals to, signals without one only count in the totals.
+    void reset(size_t signal_count, std::vector<std::pair<const Output_connector*, uint32_t>> connectors = {});
+    bool empty() const { return samples == 0; }
+    size_t size() const { return signal_count; }
+
+    // the state after a tick, signal_count bits
+    void sample(const uint64_t* words);
+
+    // ticks the window statistics cover, up to window
+    size_t window_ticks() const;
+    uint32_t toggles(uint32_t signal) const { return toggle_counts[signal]; }
+    // fraction of the window the signal was high
+    float duty_cycle(uint32_t signal) const;
+    // toggles of all signals in the window
+    uint64_t window_toggles() const { return window_toggle_total; }
+    // average toggles per signal and tick in the window
+    double toggle_rate() const;
+
+    // since the last reset
+    uint64_t total_toggles = 0;
+    uint64_t total_ticks = 0;
+
+    const std::vector<std::pair<const Output_connector*, uint32_t>>& connectors() const { return connector_signals; }
+    // window toggles of every node with attributed signals
+    std::unordered_map<const Node*, uint64_t> toggles_by_node() const;
+
+private:
+    size_t signal_count = 0;
+    size_t words_per_sample = 0;
+    uint64_t last_word_mask = 0;
+    size_t samples = 0;
+    size_t slots = 0;
+
+    // window + 1 samples, the oldest one is the previous state of the oldest tick in the window
+    std::vector<uint64_t> ring;
+    std::vector<uint32_t> toggle_counts;
+    std::vector<uint32_t> high_counts;
+    uint64_t window_toggle_total = 0;
+
+    std::vector<std::pair<const Output_connector*, uint32_t>> connector_signals;
+};
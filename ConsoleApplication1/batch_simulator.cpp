@@ -0,0 +1,135 @@
+#include "batch_simulator.h"
+
+#include "main_game.h"
+
+#include <algorithm>
+#include <iostream>
+
+static std::string pin_name(const Node* node, size_t pin, size_t pin_count)
+{
+    if (pin_count == 1) return node->label;
+    return node->label + "[" + std::to_string(pin) + "]";
+}
+
+bool BatchSimulator::compile(const std::vector<Node*>& nodes, bool flatten_functions)
+{
+    netlist.compile(nodes, flatten_functions);
+    input_signals.clear();
+    output_signals.clear();
+    in_names.clear();
+    out_names.clear();
+
+    if (netlist.opaque_count() != 0) {
+        std::cerr << "Batch simulation error: " << netlist.opaque_count() << " nodes could not be lowered\n";
+        return false;
+    }
+
+    for (uint32_t op : netlist.input_ops) {
+        Node* host = netlist.op_host[op];
+        if (!host->isInput()) continue;
+        input_signals.push_back(op);
+        in_names.push_back(pin_name(host, netlist.op_pin[op], host->outputs.size()));
+    }
+    for (const NetlistProbe& probe : netlist.probes) {
+        output_signals.push_back(probe.signal);
+        out_names.push_back(pin_name(probe.host, probe.pin, probe.host->inputs.size()));
+    }
+
+    state.assign(netlist.signal_count(), Lanes{});
+    new_state.assign(netlist.signal_count(), Lanes{});
+    return true;
+}
+
+void BatchSimulator::step()
+{
+    const size_t count = netlist.ops.size();
+    const uint32_t* fanin = netlist.fanin.data();
+    const uint32_t* fanin_begin = netlist.fanin_begin.data();
+
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t* in = fanin + fanin_begin[i];
+        const uint32_t* in_end = fanin + fanin_begin[i + 1];
+        Lanes acc{};
+
+        switch (netlist.ops[i])
+        {
+        case GateOp::AND:
+        case GateOp::NAND:
+            if (in != in_end) {
+                acc = state[*in++];
+                for (; in != in_end; ++in)
+                    for (size_t w = 0; w < batch_words; w++) acc[w] &= state[*in][w];
+            }
+            break;
+        case GateOp::OR:
+        case GateOp::NOR:
+            for (; in != in_end; ++in)
+                for (size_t w = 0; w < batch_words; w++) acc[w] |= state[*in][w];
+            break;
+        case GateOp::XOR:
+        case GateOp::XNOR:
+            for (; in != in_end; ++in)
+                for (size_t w = 0; w < batch_words; w++) acc[w] ^= state[*in][w];
+            break;
+        case GateOp::BUFFER:
+        case GateOp::NOT:
+            if (in != in_end) acc = state[*in];
+            break;
+        case GateOp::INPUT:
+        case GateOp::OPAQUE:
+            acc = state[i];
+            break;
+        case GateOp::CONST_0:
+            break;
+        }
+
+        switch (netlist.ops[i])
+        {
+        case GateOp::NAND:
+        case GateOp::NOR:
+        case GateOp::XNOR:
+        case GateOp::NOT:
+            for (size_t w = 0; w < batch_words; w++) acc[w] = ~acc[w];
+            break;
+        default:
+            break;
+        }
+
+        new_state[i] = acc;
+    }
+    state.swap(new_state);
+}
+
+std::vector<std::vector<bool>> BatchSimulator::run(const std::vector<std::vector<bool>>& stimulus, size_t ticks)
+{
+    std::vector<std::vector<bool>> results(stimulus.size(), std::vector<bool>(output_signals.size()));
+
+    for (size_t base = 0; base < stimulus.size(); base += batch_lanes()) {
+        const size_t lanes = std::min(batch_lanes(), stimulus.size() - base);
+
+        // every lane starts from the state the circuit was compiled in
+        for (size_t s = 0; s < state.size(); s++) {
+            state[s].fill(netlist.signals.get(uint32_t(s)) ? ~uint64_t(0) : 0);
+        }
+
+        for (size_t i = 0; i < input_signals.size(); i++) {
+            Lanes value{};
+            for (size_t l = 0; l < lanes; l++) {
+                const std::vector<bool>& row = stimulus[base + l];
+                if (i < row.size() && row[i]) value[l >> 6] |= uint64_t(1) << (l & 63);
+            }
+            state[input_signals[i]] = value;
+        }
+
+        for (size_t t = 0; t < ticks; t++) {
+            step();
+        }
+
+        for (size_t l = 0; l < lanes; l++) {
+            for (size_t o = 0; o < output_signals.size(); o++) {
+                results[base + l][o] = (state[output_signals[o]][l >> 6] >> (l & 63)) & 1;
+            }
+        }
+    }
+    return results;
+}
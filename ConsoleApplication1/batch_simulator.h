@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <array>
+#include <cstdint>
+
+#include "netlist.h"
+
+// Number of 64-bit words per signal. Builds with AVX2 enabled get 256 lanes, the loops over a
+// lane array are simple enough for the compiler to vectorize.
+#ifdef __AVX2__
+constexpr size_t batch_words = 4;
+#else
+constexpr size_t batch_words = 1;
+#endif
+
+// Runs the same circuit against many independent stimulus vectors at once. Every signal is a
+// word of lanes and every gate is a handful of bitwise ops, so one pass evaluates a gate for
+// batch_lanes() vectors.
+class BatchSimulator {
+public:
+    using Lanes = std::array<uint64_t, batch_words>;
+
+    static constexpr size_t batch_lanes() { return batch_words * 64; }
+
+    // Lowers the nodes, returns false if they contain nodes the netlist could not lower. FunctionNodes
+    // can only be simulated with their bodies flattened.
+    bool compile(const std::vector<Node*>& nodes, bool flatten_functions = true);
+
+    // PushButton and ToggleButton outputs, in the order the stimulus columns are read
+    const std::vector<std::string>& input_names() const { return in_names; }
+    // LightBulb and SevenSegmentDisplay inputs, in the order the result columns are written
+    const std::vector<std::string>& output_names() const { return out_names; }
+
+    // stimulus[v][i] is the value of input i in vector v. Every vector starts from the compiled
+    // state, holds its inputs for the given number of ticks and returns the outputs after that.
+    std::vector<std::vector<bool>> run(const std::vector<std::vector<bool>>& stimulus, size_t ticks);
+
+private:
+    void step();
+
+    Netlist netlist;
+    std::vector<uint32_t> input_signals;
+    std::vector<uint32_t> output_signals;
+    std::vector<std::string> in_names;
+    std::vector<std::string> out_names;
+
+    std::vector<Lanes> state;
+    std::vector<Lanes> new_state;
+};
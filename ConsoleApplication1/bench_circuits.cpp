@@ -0,0 +1,291 @@
+#include "bench_circuits.h"
+
+#include <set>
+#include <memory>
+#include <algorithm>
+
+Node* CircuitBuilder::add(const std::string& type)
+{
+    Node* node = NodeFactory::createNode(container, type);
+    // FunctionNode orders its pins by descending y, this keeps them in creation order
+    node->pos = { 0, y };
+    y -= 100;
+    container->push_back(node);
+    return node;
+}
+
+Output_connector* CircuitBuilder::input(const std::string& label)
+{
+    Node* node = add("ToggleButton");
+    node->label = label;
+    return out(node);
+}
+
+void CircuitBuilder::output(const std::string& label, Output_connector* source)
+{
+    Node* node = add("LightBulb");
+    node->label = label;
+    node->inputs[0].connect(source);
+}
+
+Node* CircuitBuilder::gate(const std::string& type, const std::vector<Output_connector*>& sources)
+{
+    Node* node = add(type);
+    while (node->inputs.size() < sources.size()) node->add_input();
+    for (size_t i = 0; i < sources.size(); i++) node->inputs[i].connect(sources[i]);
+    return node;
+}
+
+Output_connector* CircuitBuilder::clock(size_t length)
+{
+    Node* inverter = gate("GateNOT", { nullptr });
+    Output_connector* last = out(inverter);
+    for (size_t i = 1; i < length; i++) last = out(gate("GateBUFFER", { last }));
+    inverter->inputs[0].connect(last);
+    return last;
+}
+
+std::pair<Output_connector*, Output_connector*> CircuitBuilder::full_adder(Output_connector* a, Output_connector* b, Output_connector* c)
+{
+    Output_connector* p = out(gate("GateXOR", { a, b }));
+    Output_connector* sum = out(gate("GateXOR", { p, c }));
+    Output_connector* carry = out(gate("GateOR", { out(gate("GateAND", { a, b })), out(gate("GateAND", { p, c })) }));
+    return { sum, carry };
+}
+
+std::pair<Output_connector*, Output_connector*> CircuitBuilder::d_latch(Output_connector* d, Output_connector* enable)
+{
+    Output_connector* set = out(gate("GateNAND", { d, enable }));
+    Output_connector* reset = out(gate("GateNAND", { set, enable }));
+    Node* q = gate("GateNAND", { set, nullptr });
+    Node* q_n = gate("GateNAND", { reset, out(q) });
+    q->inputs[1].connect(out(q_n));
+    return { out(q), out(q_n) };
+}
+
+std::pair<Output_connector*, Output_connector*> CircuitBuilder::d_flipflop(Output_connector* d, Output_connector* clk)
+{
+    Output_connector* clk_n = out(gate("GateNOT", { clk }));
+    return d_latch(d_latch(d, clk_n).first, clk);
+}
+
+// label and index, as += since GCC warns about "name" + std::to_string(i) with -Wrestrict
+static std::string indexed(const char* name, size_t index)
+{
+    std::string label = name;
+    label += std::to_string(index);
+    return label;
+}
+
+static void build_ripple_adder(CircuitBuilder& b, size_t bits)
+{
+    std::vector<Output_connector*> x, y;
+    for (size_t i = 0; i < bits; i++) x.push_back(b.input(indexed("a", i)));
+    for (size_t i = 0; i < bits; i++) y.push_back(b.input(indexed("b", i)));
+    Output_connector* carry = b.input("cin");
+
+    for (size_t i = 0; i < bits; i++) {
+        auto [sum, carry_out] = b.full_adder(x[i], y[i], carry);
+        b.output(indexed("s", i), sum);
+        carry = carry_out;
+    }
+    b.output("cout", carry);
+}
+
+// 4 bit lookahead blocks, the carry ripples from block to block
+static void build_lookahead_adder(CircuitBuilder& b, size_t bits)
+{
+    std::vector<Output_connector*> x, y;
+    for (size_t i = 0; i < bits; i++) x.push_back(b.input(indexed("a", i)));
+    for (size_t i = 0; i < bits; i++) y.push_back(b.input(indexed("b", i)));
+    Output_connector* carry = b.input("cin");
+
+    for (size_t start = 0; start < bits; start += 4) {
+        const size_t n = std::min<size_t>(4, bits - start);
+        std::vector<Output_connector*> g, p, c = { carry };
+        for (size_t i = 0; i < n; i++) {
+            g.push_back(out(b.gate("GateAND", { x[start + i], y[start + i] })));
+            p.push_back(out(b.gate("GateXOR", { x[start + i], y[start + i] })));
+        }
+        // c[i + 1] = g[i] | p[i] g[i - 1] | ... | p[i] .. p[0] c[0]
+        for (size_t i = 0; i < n; i++) {
+            std::vector<Output_connector*> terms = { g[i] };
+            for (size_t j = i + 1; j-- > 0;) {
+                std::vector<Output_connector*> term(p.begin() + j, p.begin() + i + 1);
+                term.push_back(j == 0 ? c[0] : g[j - 1]);
+                terms.push_back(out(b.gate("GateAND", term)));
+            }
+            c.push_back(out(b.gate("GateOR", terms)));
+        }
+        for (size_t i = 0; i < n; i++) {
+            b.output(indexed("s", start + i), out(b.gate("GateXOR", { p[i], c[i] })));
+        }
+        carry = c[n];
+    }
+    b.output("cout", carry);
+}
+
+// ripple counter of toggle flip-flops, each stage clocked by the inverted output of the one before
+static void build_counter(CircuitBuilder& b, size_t bits)
+{
+    Output_connector* clk = b.clock(8);
+    for (size_t i = 0; i < bits; i++) {
+        Node* d = b.gate("GateBUFFER", { nullptr });
+        auto [q, q_n] = b.d_flipflop(out(d), clk);
+        d->inputs[0].connect(q_n);
+        b.output(indexed("q", i), q);
+        clk = q_n;
+    }
+}
+
+// shift register with XNOR feedback, so the all zero start state is not a lock up state
+static void build_lfsr(CircuitBuilder& b, size_t bits)
+{
+    Output_connector* clk = b.clock(8);
+    Node* feedback = b.gate("GateBUFFER", { nullptr });
+
+    std::vector<Output_connector*> q;
+    Output_connector* d = out(feedback);
+    for (size_t i = 0; i < bits; i++) {
+        d = b.d_flipflop(d, clk).first;
+        q.push_back(d);
+        b.output(indexed("q", i), d);
+    }
+
+    std::set<size_t> taps = { bits - 1, bits * 3 / 4, bits / 2, bits / 4 };
+    std::vector<Output_connector*> tap_signals;
+    for (size_t tap : taps) tap_signals.push_back(q[tap]);
+    if (tap_signals.size() == 1) tap_signals.push_back(tap_signals[0]);
+    feedback->inputs[0].connect(out(b.gate("GateXNOR", tap_signals)));
+}
+
+// registers of 8 latches with a write decoder and a read multiplexer sharing one address
+static void build_register_file(CircuitBuilder& b, size_t registers)
+{
+    const size_t width = 8;
+    registers = std::max<size_t>(registers, 2);
+    size_t address_bits = 0;
+    while ((size_t(1) << address_bits) < registers) address_bits++;
+
+    std::vector<Output_connector*> address, address_n, data;
+    for (size_t i = 0; i < address_bits; i++) {
+        address.push_back(b.input(indexed("addr", i)));
+        address_n.push_back(out(b.gate("GateNOT", { address.back() })));
+    }
+    for (size_t i = 0; i < width; i++) data.push_back(b.input(indexed("data", i)));
+    Output_connector* write = b.input("we");
+
+    std::vector<std::vector<Output_connector*>> read_terms(width);
+    for (size_t r = 0; r < registers; r++) {
+        std::vector<Output_connector*> select;
+        for (size_t i = 0; i < address_bits; i++) select.push_back((r >> i) & 1 ? address[i] : address_n[i]);
+        if (select.size() == 1) select.push_back(select[0]);
+        Output_connector* read_enable = out(b.gate("GateAND", select));
+        Output_connector* write_enable = out(b.gate("GateAND", { read_enable, write }));
+
+        for (size_t i = 0; i < width; i++) {
+            Output_connector* q = b.d_latch(data[i], write_enable).first;
+            read_terms[i].push_back(out(b.gate("GateAND", { q, read_enable })));
+        }
+    }
+    for (size_t i = 0; i < width; i++) {
+        b.output(indexed("q", i), out(b.gate("GateOR", read_terms[i])));
+    }
+}
+
+// Level 0 is a full adder, every level above wraps two instances of the one below it. The top
+// level is a 16 bit ripple adder made of the deepest level. Each level is one shared definition,
+// so memory grows with the depth while the gates stepped per tick double with every level.
+static void build_nested_functions(CircuitBuilder& b, size_t depth)
+{
+    std::shared_ptr<FunctionDefinition> level = FunctionDefinition::create();
+    {
+        std::vector<Node*> body;
+        CircuitBuilder inner{ &body };
+        Output_connector* x = inner.input("a");
+        Output_connector* y = inner.input("b");
+        Output_connector* c = inner.input("cin");
+        auto [sum, carry] = inner.full_adder(x, y, c);
+        inner.output("s", sum);
+        inner.output("cout", carry);
+        level->set_nodes(body);
+    }
+
+    auto instance = [&](CircuitBuilder& builder, const std::shared_ptr<FunctionDefinition>& definition, Output_connector* x, Output_connector* y, Output_connector* c) {
+        FunctionNode* function = static_cast<FunctionNode*>(builder.add("FunctionNode"));
+        function->set_definition(definition);
+        function->inputs[0].connect(x);
+        function->inputs[1].connect(y);
+        function->inputs[2].connect(c);
+        return std::make_pair(out(function, 0), out(function, 1));
+    };
+
+    for (size_t d = 0; d < depth; d++) {
+        std::vector<Node*> body;
+        CircuitBuilder inner{ &body };
+        Output_connector* x = inner.input("a");
+        Output_connector* y = inner.input("b");
+        Output_connector* c = inner.input("cin");
+        auto first = instance(inner, level, x, y, c);
+        auto second = instance(inner, level, first.first, y, first.second);
+        inner.output("s", second.first);
+        inner.output("cout", second.second);
+        level = FunctionDefinition::create();
+        level->set_nodes(body);
+    }
+
+    Output_connector* carry = b.input("cin");
+    for (size_t i = 0; i < 16; i++) {
+        Output_connector* x = b.input(indexed("a", i));
+        Output_connector* y = b.input(indexed("b", i));
+        auto [sum, carry_out] = instance(b, level, x, y, carry);
+        b.output(indexed("s", i), sum);
+        carry = carry_out;
+    }
+    b.output("cout", carry);
+}
+
+// 8 bit buses sharing one label, every driver gates the data with one of a few clocks
+static void build_bus_fanin(CircuitBuilder& b, size_t drivers)
+{
+    const size_t width = 8;
+    std::vector<Output_connector*> data, clocks;
+    for (size_t i = 0; i < width; i++) data.push_back(b.input(indexed("data", i)));
+    for (size_t i = 0; i < 4; i++) clocks.push_back(b.clock(3 + i));
+
+    Bus* first = nullptr;
+    for (size_t d = 0; d < drivers; d++) {
+        Bus* bus = dynamic_cast<Bus*>(b.add("Bus"));
+        bus->change_label("FANIN");
+        while (bus->inputs.size() < width) bus->add_input();
+        for (size_t i = 0; i < width; i++) {
+            bus->inputs[i].connect(out(b.gate("GateAND", { data[i], clocks[(d + i) % clocks.size()] })));
+        }
+        if (!first) first = bus;
+    }
+    for (size_t i = 0; first && i < first->outputs.size(); i++) {
+        b.output(indexed("q", i), out(first, i));
+    }
+}
+
+const std::vector<BenchCircuit>& bench_circuits()
+{
+    static const std::vector<BenchCircuit> circuits = {
+        { "ripple_adder", "bits", 256, build_ripple_adder },
+        { "lookahead_adder", "bits", 256, build_lookahead_adder },
+        { "counter", "bits", 64, build_counter },
+        { "lfsr", "bits", 256, build_lfsr },
+        { "register_file", "registers", 64, build_register_file },
+        { "nested_functions", "depth", 5, build_nested_functions },
+        { "bus_fanin", "drivers", 256, build_bus_fanin },
+    };
+    return circuits;
+}
+
+const BenchCircuit* find_bench_circuit(const std::string& name)
+{
+    for (const BenchCircuit& circuit : bench_circuits()) {
+        if (name == circuit.name) return &circuit;
+    }
+    return nullptr;
+}
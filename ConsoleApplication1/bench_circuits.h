@@ -0,0 +1,44 @@
+#pragma once
+// Synthetic circuits of configurable size, built the way the editor builds them. Benchmark times
+// them and the tests compare the simulation modes and the save formats on them.
+#include "main_game.h"
+
+#include <string>
+#include <vector>
+#include <utility>
+
+inline Output_connector* out(Node* node, size_t pin = 0) { return &node->outputs[pin]; }
+
+// Creates nodes through the factory the editor and the loader use, and wires them up
+struct CircuitBuilder {
+    std::vector<Node*>* container;
+    float y = 0;
+
+    Node* add(const std::string& type);
+    // a labelled ToggleButton
+    Output_connector* input(const std::string& label);
+    // a labelled LightBulb
+    void output(const std::string& label, Output_connector* source);
+    // sources may be null for feedback that is connected once the driver exists
+    Node* gate(const std::string& type, const std::vector<Output_connector*>& sources);
+
+    // square wave with a period of 2 * length ticks, a NOT closing a loop of buffers
+    Output_connector* clock(size_t length);
+    // returns { sum, carry }
+    std::pair<Output_connector*, Output_connector*> full_adder(Output_connector* a, Output_connector* b, Output_connector* c);
+    // gated SR latch from four NANDs, transparent while enable is high, returns { q, q_n }
+    std::pair<Output_connector*, Output_connector*> d_latch(Output_connector* d, Output_connector* enable);
+    // master-slave pair of latches, takes d on the rising edge of clk
+    std::pair<Output_connector*, Output_connector*> d_flipflop(Output_connector* d, Output_connector* clk);
+};
+
+struct BenchCircuit {
+    const char* name;
+    const char* size_unit;
+    size_t default_size;
+    void (*build)(CircuitBuilder&, size_t);
+};
+
+// ripple_adder, lookahead_adder, counter, lfsr, register_file, nested_functions and bus_fanin
+const std::vector<BenchCircuit>& bench_circuits();
+const BenchCircuit* find_bench_circuit(const std::string& name);
@@ -0,0 +1,276 @@
+// Builds synthetic circuits through NodeFactory and measures how fast they simulate, save and load.
+//
+//   Benchmark [--circuit name[,name...]] [--size N] [--scale F] [--ticks N]
+//             [--modes graph,compiled,event,parallel,levelized] [--threads N] [--out results.json]
+//             [--no-flatten] [--tables]
+//
+// Every circuit has its own size unit (bits, registers, nesting depth or bus drivers), --size
+// replaces the defaults and --scale multiplies them. A summary is printed and the full results
+// are written to --out as JSON, benchmark.json by default.
+
+#include "main_game.h"
+#include "bench_circuits.h"
+#include "process_memory.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <charconv>
+
+using bench_clock = std::chrono::steady_clock;
+
+static double ms_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static const char* mode_name(SimulationMode mode)
+{
+    switch (mode)
+    {
+    case GRAPH: return "graph";
+    case COMPILED: return "compiled";
+    case EVENT: return "event";
+    case PARALLEL: return "parallel";
+    case LEVELIZED: return "levelized";
+    }
+    return "";
+}
+
+// logic gates and buses, counted through FunctionNodes, the things a tick evaluates
+static size_t count_gates(const std::vector<Node*>& nodes)
+{
+    size_t count = 0;
+    for (Node* node : nodes) {
+        if (FunctionNode* function = dynamic_cast<FunctionNode*>(node)) count += count_gates(function->definition->nodes);
+        else if (node->get_type().rfind("Gate", 0) == 0 || node->get_type() == "Bus") count++;
+    }
+    return count;
+}
+
+struct BenchOptions {
+    std::vector<const BenchCircuit*> circuits;
+    std::vector<SimulationMode> modes = { GRAPH, COMPILED, EVENT, PARALLEL, LEVELIZED };
+    size_t size = 0;
+    double scale = 1.0;
+    size_t ticks = 10000;
+    int threads = 0;
+    std::string out_path = "benchmark.json";
+    bool flatten = true;
+    bool tables = false;
+};
+
+static std::vector<std::string> split_list(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// the whole of text as a number, false for anything else including a sign on an unsigned value
+template <typename T>
+static bool parse_number(const char* text, T& value)
+{
+    const char* end = text + std::strlen(text);
+    auto [last, error] = std::from_chars(text, end, value);
+    return error == std::errc() && last == end;
+}
+
+static bool parse_args(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        auto number = [&](auto& value) {
+            if (parse_number(argv[++i], value)) return true;
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << "\n";
+            return false;
+        };
+
+        if (arg == "--size" && has_value) {
+            if (!number(options.size)) return false;
+        }
+        else if (arg == "--scale" && has_value) {
+            if (!number(options.scale)) return false;
+        }
+        else if (arg == "--ticks" && has_value) {
+            if (!number(options.ticks)) return false;
+        }
+        else if (arg == "--threads" && has_value) {
+            if (!number(options.threads)) return false;
+        }
+        else if (arg == "--out" && has_value) options.out_path = argv[++i];
+        else if (arg == "--no-flatten") options.flatten = false;
+        else if (arg == "--tables") options.tables = true;
+        else if (arg == "--circuit" && has_value) {
+            for (const std::string& name : split_list(argv[++i])) {
+                const BenchCircuit* found = find_bench_circuit(name);
+                if (!found) {
+                    std::cerr << "Unknown circuit: " << name << "\n";
+                    return false;
+                }
+                options.circuits.push_back(found);
+            }
+        }
+        else if (arg == "--modes" && has_value) {
+            options.modes.clear();
+            for (const std::string& name : split_list(argv[++i])) {
+                bool found = false;
+                for (SimulationMode mode : { GRAPH, COMPILED, EVENT, PARALLEL, LEVELIZED }) {
+                    if (name == mode_name(mode)) {
+                        options.modes.push_back(mode);
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    std::cerr << "Unknown mode: " << name << "\n";
+                    return false;
+                }
+            }
+        }
+        else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return false;
+        }
+    }
+    if (options.circuits.empty()) {
+        for (const BenchCircuit& circuit : bench_circuits()) options.circuits.push_back(&circuit);
+    }
+    return true;
+}
+
+static json run_circuit(const BenchCircuit& circuit, size_t size, const BenchOptions& options)
+{
+    Game& game = Game::getInstance();
+    json result = { {"circuit", circuit.name}, {"size", size}, {"size_unit", circuit.size_unit} };
+
+    bench_clock::time_point start = bench_clock::now();
+    CircuitBuilder builder{ &game.nodes };
+    circuit.build(builder, size);
+    result["build_ms"] = ms_since(start);
+    result["nodes"] = game.nodes.size();
+    const size_t gates = count_gates(game.nodes);
+    result["gates"] = gates;
+
+    // round trip through the editor's own save and load in both formats, the simulation runs on the last loaded copy
+    for (const char* format : { "json", "lgsb" }) {
+        std::string prefix = std::string(format) == "json" ? "" : "binary_";
+        std::string path = (std::filesystem::temp_directory_path() / (std::string("logisim_benchmark.") + format)).string();
+        start = bench_clock::now();
+        game.save(path);
+        result[prefix + "save_ms"] = ms_since(start);
+        result[prefix + "file_bytes"] = std::filesystem::file_size(path);
+
+        // load replaces the circuit, deleting it first keeps that out of the time
+        for (Node* node : game.nodes) delete node;
+        game.nodes.clear();
+        start = bench_clock::now();
+        game.load(path);
+        result[prefix + "load_ms"] = ms_since(start);
+        std::filesystem::remove(path);
+    }
+
+    std::vector<Node*> inputs;
+    for (Node* node : game.nodes) {
+        if (node->isInput()) inputs.push_back(node);
+    }
+
+    json modes = json::object();
+    for (SimulationMode mode : options.modes) {
+        game.sim_mode = mode;
+        game.invalidate_netlist();
+
+        // the first tick compiles the netlist for the compiled modes
+        start = bench_clock::now();
+        game.pretick();
+        game.tick();
+        double first_tick_ms = ms_since(start);
+
+        start = bench_clock::now();
+        for (size_t t = 0; t < options.ticks; t++) {
+            // keep the inputs moving so the event driven mode has something to do
+            if (t % 16 == 0 && !inputs.empty()) {
+                Node* input = inputs[(t / 16) % inputs.size()];
+                input->outputs[0].state = !input->outputs[0].state;
+                input->has_changed = true;
+            }
+            game.pretick();
+            game.tick();
+        }
+        double seconds = ms_since(start) / 1000.0;
+
+        modes[mode_name(mode)] = {
+            {"first_tick_ms", first_tick_ms},
+            {"ticks", options.ticks},
+            {"seconds", seconds},
+            {"ticks_per_second", options.ticks / seconds},
+            {"ns_per_gate", gates ? seconds * 1e9 / (double(options.ticks) * gates) : 0.0},
+        };
+    }
+    result["modes"] = modes;
+    // process wide, so it only grows over the run
+    result["peak_memory_bytes"] = peak_memory_bytes();
+
+    for (Node* node : game.nodes) delete node;
+    game.nodes.clear();
+    game.invalidate_netlist();
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!parse_args(argc, argv, options)) {
+        std::cerr << "usage: Benchmark [--circuit name[,name...]] [--size N] [--scale F] [--ticks N]\n"
+                     "                 [--modes graph,compiled,event,parallel,levelized] [--threads N] [--out results.json]\n"
+                     "                 [--no-flatten] [--tables]\n";
+        return 2;
+    }
+
+    Game& game = Game::getInstance();
+    game.sim_on_thread = false;
+    if (options.threads > 0) game.sim_threads = options.threads;
+    game.flatten_functions = options.flatten;
+    game.function_tables = options.tables;
+
+    json results = {
+        {"built", __DATE__ " " __TIME__},
+        {"ticks", options.ticks},
+        {"threads", game.sim_threads},
+        {"flatten_functions", game.flatten_functions},
+        {"function_tables", game.function_tables},
+        {"results", json::array()},
+    };
+
+    for (const BenchCircuit* circuit : options.circuits) {
+        size_t size = options.size ? options.size : std::max<size_t>(1, size_t(circuit->default_size * options.scale));
+        json result = run_circuit(*circuit, size, options);
+
+        std::cout << circuit->name << " (" << size << " " << circuit->size_unit << ", " << result["gates"] << " gates)"
+                  << ": build " << result["build_ms"].get<double>() << " ms, save " << result["save_ms"].get<double>()
+                  << " ms, load " << result["load_ms"].get<double>() << " ms, binary save " << result["binary_save_ms"].get<double>()
+                  << " ms, binary load " << result["binary_load_ms"].get<double>() << " ms\n";
+        for (auto& [mode, stats] : result["modes"].items()) {
+            std::cout << "    " << mode << ": " << stats["ticks_per_second"].get<double>() << " ticks/s, "
+                      << stats["ns_per_gate"].get<double>() << " ns/gate\n";
+        }
+        results["results"].push_back(result);
+    }
+
+    std::ofstream out_file(options.out_path);
+    if (!out_file.is_open()) {
+        std::cerr << "Unable to open " << options.out_path << "\n";
+        return 1;
+    }
+    out_file << results.dump(4);
+    std::cout << "results written to " << options.out_path << "\n";
+    return 0;
+}
@@ -0,0 +1,347 @@
+#include "binary_save.h"
+#include "main_game.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+void BinaryWriter::u32(uint32_t value)
+{
+    for (int i = 0; i < 4; i++) u8(uint8_t(value >> (8 * i)));
+}
+
+void BinaryWriter::f32(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    u32(bits);
+}
+
+void BinaryWriter::varint(uint64_t value)
+{
+    while (value >= 0x80) {
+        u8(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    u8(uint8_t(value));
+}
+
+void BinaryWriter::string(const std::string& value)
+{
+    varint(value.size());
+    bytes.insert(bytes.end(), value.begin(), value.end());
+}
+
+void BinaryWriter::bits(const std::vector<bool>& values)
+{
+    varint(values.size());
+    for (size_t i = 0; i < values.size(); i += 8) {
+        uint8_t packed = 0;
+        for (size_t j = 0; j < 8 && i + j < values.size(); j++) {
+            if (values[i + j]) packed |= uint8_t(1 << j);
+        }
+        u8(packed);
+    }
+}
+
+uint32_t BinaryWriter::type_index(const std::string& type)
+{
+    auto [it, added] = type_indices.emplace(type, uint32_t(types.size()));
+    if (added) types.push_back(type);
+    return it->second;
+}
+
+uint32_t BinaryWriter::definition_index(const FunctionDefinition* definition)
+{
+    auto [it, added] = definition_indices.emplace(definition, uint32_t(definition_indices.size()));
+    return it->second;
+}
+
+const uint8_t* BinaryReader::take(size_t n)
+{
+    if (failed || n > size - offset) {
+        failed = true;
+        return nullptr;
+    }
+    const uint8_t* retval = data + offset;
+    offset += n;
+    return retval;
+}
+
+uint8_t BinaryReader::u8()
+{
+    const uint8_t* bytes = take(1);
+    return bytes ? bytes[0] : 0;
+}
+
+uint32_t BinaryReader::u32()
+{
+    const uint8_t* bytes = take(4);
+    if (!bytes) return 0;
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= uint32_t(bytes[i]) << (8 * i);
+    return value;
+}
+
+float BinaryReader::f32()
+{
+    uint32_t bits = u32();
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t BinaryReader::varint()
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        const uint8_t* byte = take(1);
+        if (!byte) return 0;
+        value |= uint64_t(*byte & 0x7f) << shift;
+        if (!(*byte & 0x80)) return value;
+    }
+    failed = true;
+    return 0;
+}
+
+size_t BinaryReader::count()
+{
+    uint64_t value = varint();
+    if (value > size - offset) {
+        failed = true;
+        return 0;
+    }
+    return size_t(value);
+}
+
+std::string BinaryReader::string()
+{
+    size_t length = count();
+    const uint8_t* bytes = take(length);
+    return bytes ? std::string(reinterpret_cast<const char*>(bytes), length) : std::string();
+}
+
+std::vector<bool> BinaryReader::bits()
+{
+    uint64_t length = varint();
+    if (length / 8 > size - offset) {
+        failed = true;
+        return {};
+    }
+    const uint8_t* bytes = take(size_t((length + 7) / 8));
+    if (!bytes) return {};
+
+    std::vector<bool> values(length);
+    for (size_t i = 0; i < length; i++) values[i] = (bytes[i / 8] >> (i % 8)) & 1;
+    return values;
+}
+
+void NodeNetworkToBinary(BinaryWriter& writer, const std::vector<Node*>& nodes)
+{
+    // dense index of the first output of every node, inputs refer to outputs through these
+    std::unordered_map<const Node*, size_t> first_output;
+    size_t output_count = 0;
+    for (const Node* node : nodes) {
+        first_output[node] = output_count;
+        output_count += node->outputs.size();
+    }
+
+    writer.varint(nodes.size());
+    for (const Node* node : nodes) {
+        writer.varint(writer.type_index(node->get_type()));
+        writer.f32(node->pos.x);
+        writer.f32(node->pos.y);
+        writer.f32(node->size.x);
+        writer.f32(node->size.y);
+        writer.string(node->label);
+
+        std::vector<bool> states;
+        for (const Output_connector& output : node->outputs) states.push_back(output.state);
+        writer.bits(states);
+
+        writer.varint(node->inputs.size());
+        for (const Input_connector& input : node->inputs) {
+            // targets outside this network are saved unconnected, the JSON loader drops them too
+            auto found = input.target ? first_output.find(input.target->host) : first_output.end();
+            writer.varint(found != first_output.end() ? found->second + input.target->index + 1 : 0);
+        }
+
+        node->save_extra_binary(writer);
+    }
+}
+
+bool NodeNetworkFromBinary(BinaryReader& reader, std::vector<Node*>* nodes)
+{
+    const size_t first_new = nodes->size();
+    std::vector<uint64_t> targets; // one per input of the new nodes, in order
+
+    size_t node_count = reader.count();
+    for (size_t n = 0; n < node_count && !reader.failed; n++) {
+        uint64_t type = reader.varint();
+        if (type >= reader.types.size()) {
+            reader.failed = true;
+            break;
+        }
+        Node* node = NodeFactory::createNode(nodes, reader.types[type]);
+        if (!node) {
+            std::cerr << "Binary save error: unknown node type " << reader.types[type] << "\n";
+            reader.failed = true;
+            break;
+        }
+
+        node->pos.x = reader.f32();
+        node->pos.y = reader.f32();
+        node->size.x = reader.f32();
+        node->size.y = reader.f32();
+        node->label = reader.string();
+
+        for (Input_connector& input : node->inputs) {
+            input.disconnect();
+        }
+        node->inputs.clear();
+        for (Output_connector& output : node->outputs) {
+            output.disconnect_readers();
+        }
+        node->outputs.clear();
+
+        std::vector<bool> states = reader.bits();
+        for (size_t i = 0; i < states.size(); i++) {
+            node->outputs.push_back(Output_connector(node, i, states[i]));
+        }
+        size_t input_count = reader.count();
+        for (size_t i = 0; i < input_count; i++) {
+            node->inputs.push_back(Input_connector(node, i));
+            targets.push_back(reader.varint());
+        }
+
+        node->load_extra_binary(reader);
+        nodes->push_back(node);
+    }
+
+    // every node exists now, so the outputs have stopped moving
+    std::vector<Output_connector*> outputs;
+    for (size_t i = first_new; i < nodes->size(); i++) {
+        for (Output_connector& output : (*nodes)[i]->outputs) outputs.push_back(&output);
+    }
+
+    size_t t = 0;
+    for (size_t i = first_new; i < nodes->size() && !reader.failed; i++) {
+        for (Input_connector& input : (*nodes)[i]->inputs) {
+            uint64_t target = targets[t++];
+            if (target > outputs.size()) reader.failed = true;
+            else if (target) input.connect(outputs[target - 1]);
+        }
+    }
+
+    if (reader.failed) {
+        for (size_t i = first_new; i < nodes->size(); i++) delete (*nodes)[i];
+        nodes->resize(first_new);
+        return false;
+    }
+    return true;
+}
+
+bool is_binary_save(const uint8_t* data, size_t size)
+{
+    return size >= sizeof(binary_save_magic) && std::memcmp(data, binary_save_magic, sizeof(binary_save_magic)) == 0;
+}
+
+static void write_definitions(BinaryWriter& writer, const std::vector<Node*>& nodes)
+{
+    std::vector<const FunctionDefinition*> definitions = CollectFunctionDefinitions(nodes);
+    writer.varint(definitions.size());
+    for (const FunctionDefinition* definition : definitions) {
+        writer.definition_index(definition);
+        writer.varint(definition->id);
+        writer.string(definition->label);
+        NodeNetworkToBinary(writer, definition->nodes);
+    }
+}
+
+static void read_definitions(BinaryReader& reader)
+{
+    size_t definition_count = reader.count();
+    for (size_t i = 0; i < definition_count && !reader.failed; i++) {
+        connector_id_t id = connector_id_t(reader.varint());
+        std::string label = reader.string();
+        std::vector<Node*> body;
+        if (!NodeNetworkFromBinary(reader, &body)) return;
+
+        // a definition that is already alive is shared, the copy in the file is dropped
+        std::shared_ptr<FunctionDefinition> definition = FunctionDefinition::find(id);
+        if (definition) {
+            for (Node* node : body) delete node;
+        }
+        else {
+            definition = FunctionDefinition::create(id);
+            definition->label = label;
+            definition->set_nodes(body);
+        }
+        reader.definitions.push_back(definition);
+    }
+}
+
+bool save_binary_file(const std::string& filePath, const std::string& label, const Camera2D& camera, const std::vector<Node*>& nodes)
+{
+    // the type table goes in front of the nodes but is only complete once they are written
+    BinaryWriter body;
+    write_definitions(body, nodes);
+    NodeNetworkToBinary(body, nodes);
+
+    BinaryWriter header;
+    for (char c : binary_save_magic) header.u8(uint8_t(c));
+    header.u32(binary_save_version);
+    header.string(label);
+    header.f32(camera.offset.x);
+    header.f32(camera.offset.y);
+    header.f32(camera.target.x);
+    header.f32(camera.target.y);
+    header.f32(camera.rotation);
+    header.f32(camera.zoom);
+    header.varint(body.types.size());
+    for (const std::string& type : body.types) header.string(type);
+
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file for writing: " << filePath << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(header.bytes.data()), header.bytes.size());
+    file.write(reinterpret_cast<const char*>(body.bytes.data()), body.bytes.size());
+    return file.good();
+}
+
+bool load_binary_save(const uint8_t* data, size_t size, Camera2D* camera, std::vector<Node*>* nodes)
+{
+    if (!is_binary_save(data, size)) {
+        std::cerr << "Binary save error: not a binary save\n";
+        return false;
+    }
+
+    BinaryReader reader(data + sizeof(binary_save_magic), size - sizeof(binary_save_magic));
+    reader.version = reader.u32();
+    if (reader.version > binary_save_version) {
+        std::cerr << "Binary save error: format version " << reader.version << " is newer than this build reads (" << binary_save_version << ")\n";
+        return false;
+    }
+    reader.string(); // label, the JSON saves don't read theirs back either
+
+    Camera2D loaded_camera;
+    loaded_camera.offset.x = reader.f32();
+    loaded_camera.offset.y = reader.f32();
+    loaded_camera.target.x = reader.f32();
+    loaded_camera.target.y = reader.f32();
+    loaded_camera.rotation = reader.f32();
+    loaded_camera.zoom = reader.f32();
+
+    size_t type_count = reader.count();
+    for (size_t i = 0; i < type_count; i++) reader.types.push_back(reader.string());
+    if (reader.version >= 2) read_definitions(reader);
+
+    if (reader.failed || !NodeNetworkFromBinary(reader, nodes)) {
+        std::cerr << "Binary save error: the file is truncated or corrupt\n";
+        return false;
+    }
+    if (camera) *camera = loaded_camera;
+    return true;
+}
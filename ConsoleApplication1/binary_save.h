@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#include "raylib.h"
+
+struct Node;
+struct FunctionDefinition;
+
+// Compact alternative to the JSON saves. Little endian, counts and indices are LEB128 varints.
+//
+//   "LGSB" u32 version, string label, 6 x f32 camera (offset, target, rotation, zoom)
+//   varint type count, type names
+//   varint definition count, per function definition varint id, string label, network
+//   network
+//
+//   network: varint node count, then per node
+//       varint type index, 4 x f32 pos and size, string label
+//       varint output count, output states packed 8 per byte
+//       varint input count, varint target per input: 0 unconnected, otherwise 1 + the index of the
+//           output counted over all outputs of the network in node order
+//       type specific data, a FunctionNode stores the index of its definition and its state bits
+//
+// Dense indices replace the connector ids, those are generated fresh on load. Definitions come
+// after every definition their body uses. Version 1 had no definitions, every FunctionNode stored
+// its nodes as a nested network.
+constexpr char binary_save_magic[4] = { 'L', 'G', 'S', 'B' };
+constexpr uint32_t binary_save_version = 2;
+
+class BinaryWriter {
+public:
+    void u8(uint8_t value) { bytes.push_back(value); }
+    void u32(uint32_t value);
+    void f32(float value);
+    void varint(uint64_t value);
+    void string(const std::string& value);
+    void bits(const std::vector<bool>& values);
+
+    // index into the type table, adding the type the first time it is seen
+    uint32_t type_index(const std::string& type);
+    // index into the definition table, definitions are numbered in the order they are written
+    uint32_t definition_index(const FunctionDefinition* definition);
+
+    std::vector<uint8_t> bytes;
+    std::vector<std::string> types;
+
+private:
+    std::unordered_map<std::string, uint32_t> type_indices;
+    std::unordered_map<const FunctionDefinition*, uint32_t> definition_indices;
+};
+
+// Reads from memory it doesn't own. Running off the end, or a count larger than the bytes left,
+// sets failed and makes every later read return zero, so callers check failed once at the end.
+class BinaryReader {
+public:
+    BinaryReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    uint8_t u8();
+    uint32_t u32();
+    float f32();
+    uint64_t varint();
+    std::string string();
+    std::vector<bool> bits();
+
+    // a varint that sizes something made of at least one byte per element
+    size_t count();
+
+    bool failed = false;
+    uint32_t version = binary_save_version;
+    std::vector<std::string> types;
+    std::vector<std::shared_ptr<FunctionDefinition>> definitions;
+
+private:
+    const uint8_t* take(size_t n);
+
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+};
+
+void NodeNetworkToBinary(BinaryWriter& writer, const std::vector<Node*>& nodes);
+// Appends the nodes to the container, connected among themselves. Returns false if the data was malformed.
+bool NodeNetworkFromBinary(BinaryReader& reader, std::vector<Node*>* nodes);
+
+bool is_binary_save(const uint8_t* data, size_t size);
+
+// Whole save files, Game::save picks this format for .lgsb paths and Game::load detects it
+bool save_binary_file(const std::string& filePath, const std::string& label, const Camera2D& camera, const std::vector<Node*>& nodes);
+bool load_binary_save(const uint8_t* data, size_t size, Camera2D* camera, std::vector<Node*>* nodes);
@@ -1,4 +1,6 @@
 #include "file_dialogs.h"
+
+#ifdef _WIN32
 #include <windows.h>
 
 std::string open_file_dialog_json()
@@ -11,7 +13,7 @@ std::string open_file_dialog_json()
     ofn.lpstrFile = new CHAR[MAX_PATH]; // Buffer to store the file name
     ofn.lpstrFile[0] = '\0';
     ofn.nMaxFile = MAX_PATH;
-    ofn.lpstrFilter = "Json Files\0*.json\0\0"; // Filter to specify the extension
+    ofn.lpstrFilter = "Save Files\0*.json;*.lgsb\0\0"; // Filter to specify the extension
     ofn.nFilterIndex = 1;
     ofn.lpstrFileTitle = NULL;
     ofn.nMaxFileTitle = 0;
@@ -50,7 +52,7 @@ std::string ShowSaveFileDialogJson()
     ofn.lpstrFile = szFile;
     ofn.lpstrFile[0] = '\0'; // Ensure the file name is initially empty
     ofn.nMaxFile = sizeof(szFile);
-    ofn.lpstrFilter = "Json Files (*.json)\0";
+    ofn.lpstrFilter = "Json Files (*.json)\0*.json\0Binary Saves (*.lgsb)\0*.lgsb\0\0";
     ofn.nFilterIndex = 1; // Default to showing text files first
     ofn.lpstrFileTitle = NULL;
     ofn.nMaxFileTitle = 0;
@@ -76,3 +78,20 @@ std::string ShowSaveFileDialogJson()
 
     return ""; // Return an empty string if the dialog is canceled or an error occurs
 }
+
+#else
+#include <iostream>
+
+// no native dialog outside windows, callers treat an empty path as cancelled
+std::string open_file_dialog_json()
+{
+    std::cout << "File dialogs are only available on windows\n";
+    return "";
+}
+
+std::string ShowSaveFileDialogJson()
+{
+    std::cout << "File dialogs are only available on windows\n";
+    return "";
+}
+#endif
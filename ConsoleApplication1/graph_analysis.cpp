@@ -0,0 +1,169 @@
+#include "graph_analysis.h"
+
+#include "main_game.h"
+
+#include <algorithm>
+
+void GraphAnalysis::analyze(const std::vector<Node*>& nodes, const std::vector<Node*>& sinks)
+{
+    connectors.clear();
+    index.clear();
+    for (Node* node : nodes) {
+        for (Output_connector& output : node->outputs) {
+            index[&output] = uint32_t(connectors.size());
+            connectors.push_back(&output);
+        }
+    }
+    const size_t n = connectors.size();
+
+    // connected_inputs is a scan of the container for buses, so it is asked once per connector
+    fanin_begin.assign(1, 0);
+    fanin.clear();
+    for (Output_connector* conn : connectors) {
+        for (Input_connector* in : conn->host->connected_inputs(conn->index)) {
+            if (!in->target) continue;
+            auto it = index.find(in->target);
+            if (it != index.end()) fanin.push_back(it->second);
+        }
+        fanin_begin.push_back(uint32_t(fanin.size()));
+    }
+
+    components.find(fanin_begin, fanin);
+    const std::vector<uint32_t>& component = components.component;
+
+    std::vector<bool> reached(n, false);
+    for (Node* sink : sinks) {
+        for (Input_connector& in : sink->inputs) {
+            if (!in.target) continue;
+            auto it = index.find(in.target);
+            if (it != index.end()) reached[it->second] = true;
+        }
+    }
+
+    // components in descending order visit every connector before the ones it depends on
+    cyclic = false;
+    depth.assign(n, 0);
+    int max_delay = 1;
+    for (auto it = components.members.rbegin(); it != components.members.rend(); ++it) {
+        uint32_t c = *it;
+        if (!reached[c]) continue;
+        Node* host = connectors[c]->host;
+        if (components.loops[component[c]] || host->is_cyclic()) cyclic = true;
+        // pins end every path, the delay counts from them
+        if (host->isInput()) continue;
+
+        int arrival = depth[c] + host->delay();
+        max_delay = std::max(max_delay, arrival);
+        for (uint32_t i = fanin_begin[c]; i < fanin_begin[c + 1]; i++) {
+            reached[fanin[i]] = true;
+            depth[fanin[i]] = std::max(depth[fanin[i]], arrival);
+        }
+    }
+    delay = cyclic ? -1 : max_delay;
+
+    // components in ascending order come after every component they depend on
+    std::vector<uint32_t> component_level(components.count(), 0);
+    for (uint32_t c : components.members) {
+        for (uint32_t i = fanin_begin[c]; i < fanin_begin[c + 1]; i++) {
+            uint32_t driver = component[fanin[i]];
+            if (driver != component[c]) component_level[component[c]] = std::max(component_level[component[c]], component_level[driver] + 1);
+        }
+    }
+    level.resize(n);
+    for (uint32_t c = 0; c < n; c++) level[c] = component_level[component[c]];
+
+    // The levels of the connectors don't order the nodes, a node with several outputs can have one
+    // far above the output another node reads. A node depends on the nodes driving what its outputs
+    // read, a node without outputs on the ones driving its inputs.
+    std::unordered_map<const Node*, uint32_t> node_index;
+    for (uint32_t i = 0; i < nodes.size(); i++) node_index[nodes[i]] = i;
+    std::vector<uint32_t> node_fanin_begin(1, 0);
+    std::vector<uint32_t> node_fanin;
+    for (Node* node : nodes) {
+        for (Output_connector& output : node->outputs) {
+            uint32_t c = index[&output];
+            for (uint32_t i = fanin_begin[c]; i < fanin_begin[c + 1]; i++) {
+                node_fanin.push_back(node_index[connectors[fanin[i]]->host]);
+            }
+        }
+        if (node->outputs.empty()) {
+            for (Input_connector& in : node->inputs) {
+                auto it = in.target ? node_index.find(in.target->host) : node_index.end();
+                if (it != node_index.end()) node_fanin.push_back(it->second);
+            }
+        }
+        node_fanin_begin.push_back(uint32_t(node_fanin.size()));
+    }
+    node_components.find(node_fanin_begin, node_fanin);
+    node_loops = std::find(node_components.loops.begin(), node_components.loops.end(), true) != node_components.loops.end();
+
+    // components in ascending order come after every component they depend on
+    linear_order.clear();
+    for (uint32_t v : node_components.members) linear_order.push_back(nodes[v]);
+}
+
+void StrongComponents::find(const std::vector<uint32_t>& fanin_begin, const std::vector<uint32_t>& fanin)
+{
+    // Tarjan's algorithm with an explicit call stack, long chains of gates would overflow the real one
+    const uint32_t unvisited = UINT32_MAX;
+    const size_t n = fanin_begin.size() - 1;
+    std::vector<uint32_t> visit_order(n, unvisited);
+    std::vector<uint32_t> low(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<uint32_t> stack;
+    std::vector<std::pair<uint32_t, uint32_t>> calls; // vertex and the next fanin to look at
+    uint32_t counter = 0;
+
+    component.assign(n, 0);
+    members.clear();
+    members.reserve(n);
+    member_begin.assign(1, 0);
+    loops.clear();
+
+    auto visit = [&](uint32_t v) {
+        visit_order[v] = low[v] = counter++;
+        stack.push_back(v);
+        on_stack[v] = true;
+        calls.push_back({ v, fanin_begin[v] });
+    };
+
+    for (uint32_t root = 0; root < n; root++) {
+        if (visit_order[root] != unvisited) continue;
+        visit(root);
+
+        while (!calls.empty()) {
+            uint32_t v = calls.back().first;
+            uint32_t next = calls.back().second;
+            if (next < fanin_begin[v + 1]) {
+                calls.back().second++;
+                uint32_t w = fanin[next];
+                if (visit_order[w] == unvisited) visit(w);
+                else if (on_stack[w]) low[v] = std::min(low[v], visit_order[w]);
+                continue;
+            }
+
+            calls.pop_back();
+            if (!calls.empty()) {
+                uint32_t parent = calls.back().first;
+                low[parent] = std::min(low[parent], low[v]);
+            }
+            if (low[v] != visit_order[v]) continue;
+
+            // v is the root of a component, everything above it on the stack belongs to it
+            bool loop = stack.back() != v;
+            for (uint32_t i = fanin_begin[v]; i < fanin_begin[v + 1]; i++) {
+                if (fanin[i] == v) loop = true;
+            }
+            uint32_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                on_stack[w] = false;
+                component[w] = uint32_t(count());
+                members.push_back(w);
+            } while (w != v);
+            member_begin.push_back(uint32_t(members.size()));
+            loops.push_back(loop);
+        }
+    }
+}
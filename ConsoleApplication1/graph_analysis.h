@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+struct Node;
+struct Output_connector;
+
+// Strongly connected components of a graph given as fanin lists, vertex v depends on
+// fanin[fanin_begin[v] .. fanin_begin[v + 1]]. Shared by GraphAnalysis and the levelized netlist.
+struct StrongComponents {
+    // Component of each vertex. Components are numbered drivers first, a component only depends on
+    // itself and lower numbered ones.
+    std::vector<uint32_t> component;
+    // the vertices by component, those of component c are members[member_begin[c] .. member_begin[c + 1]]
+    std::vector<uint32_t> members;
+    std::vector<uint32_t> member_begin;
+    // components that are a feedback loop, more than one vertex or a vertex depending on itself
+    std::vector<bool> loops;
+
+    size_t count() const { return loops.size(); }
+    void find(const std::vector<uint32_t>& fanin_begin, const std::vector<uint32_t>& fanin);
+};
+
+// Timing structure of a node network: its feedback loops, the longest path to its outputs and a
+// levelized order that steps drivers before the nodes they drive. The graph has one vertex per
+// output connector and an edge from a connector to every connector driving the inputs its value
+// depends on, as given by Node::connected_inputs. Everything is linear in the size of the graph, owners
+// keep the result until the network changes.
+class GraphAnalysis {
+public:
+    // sinks are the nodes whose inputs count as the outputs of the network, the output nodes of a
+    // function body. Cycles and the delay only consider what the sinks depend on.
+    void analyze(const std::vector<Node*>& nodes, const std::vector<Node*>& sinks);
+
+    // a loop the sinks depend on, or a cyclic function they depend on
+    bool cyclic = false;
+    // the most node delays on a path from a pin or source to a sink, at least 1, -1 if cyclic
+    int delay = -1;
+
+    // every output connector of the network in node order, and its index
+    std::vector<Output_connector*> connectors;
+    std::unordered_map<const Output_connector*, uint32_t> index;
+
+    // the feedback loops, over the connectors
+    StrongComponents components;
+
+    // the node delays on the longest path from a connector to the sinks, not counting its own node
+    std::vector<int> depth;
+    // Longest chain of components driving a connector, 0 for connectors that read nothing in the
+    // network. Every connector of a loop has the level of the loop.
+    std::vector<uint32_t> level;
+
+    // The feedback loops over the nodes, a node depending on the nodes that drive what it reads.
+    // Nodes can form a loop without their connectors doing so, a widened gate with one output
+    // driving another node and another output reading it.
+    StrongComponents node_components;
+    // any loop over the nodes, anywhere in the network
+    bool node_loops = false;
+    // The nodes in dependency order, every node after the nodes driving it. The nodes of a loop
+    // come together in no particular order, one pass over them only settles without node_loops.
+    std::vector<Node*> linear_order;
+
+private:
+    // the connectors each connector depends on, fanin[fanin_begin[i] .. fanin_begin[i + 1]]
+    std::vector<uint32_t> fanin_begin;
+    std::vector<uint32_t> fanin;
+};
@@ -6,7 +6,7 @@
 #undef RAYGUI_IMPLEMENTATION
 #include "raygui.h"
 #include "file_dialogs.h"
-#include <fstream>
+#include <filesystem>
 
 void edit_mode_changed() {
     Game::getInstance().unselect_all();
@@ -72,13 +72,66 @@ bool MenuAreaButtons() {
 bool SimulationButtons() {
     Game& game = Game::getInstance();
 
-    float menu_area_w = 100, menu_area_h = 50;
+    float menu_area_w = 1130, menu_area_h = 50;
     Rectangle menu_area{ 300, 10, menu_area_w, menu_area_h };
     GuiGroupBox(menu_area, NULL);
 
-    Rectangle save_button_area{ menu_area.x + 10, menu_area.y + 10, menu_area.width - 20, menu_area.height - 20 };
+    Rectangle save_button_area{ menu_area.x + 10, menu_area.y + 10, 80, menu_area.height - 20 };
     GuiToggle(save_button_area, "efficient_sim", &game.efficient_simulation);
 
+    Rectangle flatten_area{ save_button_area.x + save_button_area.width + 10, menu_area.y + 10, 80, menu_area.height - 20 };
+    bool flatten_functions = game.flatten_functions;
+    GuiToggle(flatten_area, "flatten", &flatten_functions);
+    if (flatten_functions != game.flatten_functions) {
+        game.flatten_functions = flatten_functions;
+        game.invalidate_netlist();
+    }
+
+    Rectangle tables_area{ flatten_area.x + flatten_area.width + 10, menu_area.y + 10, 80, menu_area.height - 20 };
+    GuiToggle(tables_area, "tables", &game.function_tables);
+
+    Rectangle profile_area{ tables_area.x + tables_area.width + 10, menu_area.y + 10, 80, menu_area.height - 20 };
+    bool profile = game.profiler.enabled;
+    GuiToggle(profile_area, "profile", &profile);
+    if (profile && !game.profiler.enabled) game.profiler.clear();
+    game.profiler.enabled = profile;
+
+    Rectangle export_area{ profile_area.x + profile_area.width + 10, menu_area.y + 10, 80, menu_area.height - 20 };
+    if (GuiButton(export_area, "export")) {
+        game.profiler.save("profile.csv");
+        game.profiler.save("profile.json");
+    }
+
+    Rectangle activity_area{ export_area.x + export_area.width + 10, menu_area.y + 10, 80, menu_area.height - 20 };
+    bool activity = game.activity.enabled;
+    GuiToggle(activity_area, "activity", &activity);
+    if (activity && !game.activity.enabled) game.restart_activity();
+    game.activity.enabled = activity;
+
+    Rectangle record_area{ activity_area.x + activity_area.width + 10, menu_area.y + 10, 80, menu_area.height - 20 };
+    bool record = game.recording_waveform();
+    GuiToggle(record_area, "record", &record);
+    if (record && !game.recording_waveform()) game.start_waveform("waveform.vcd");
+    if (!record && game.recording_waveform()) game.stop_waveform();
+
+    static int sim_mode;
+    Rectangle sim_mode_area{ record_area.x + record_area.width + 10, menu_area.y + 10, (menu_area.width - save_button_area.width - flatten_area.width - tables_area.width - profile_area.width - export_area.width - activity_area.width - record_area.width - 190) / 5.0f, menu_area.height - 20 };
+    GuiToggleGroup(sim_mode_area, "GRAPH;COMPILED;EVENT;PARALLEL;LEVELIZED", &sim_mode);
+
+    static bool threads_edit = false;
+    Rectangle threads_area{ menu_area.x + menu_area.width - 100, menu_area.y + 10, 90, menu_area.height - 20 };
+    int sim_threads = game.sim_threads;
+    if (GuiSpinner(threads_area, NULL, &sim_threads, 1, 64, threads_edit)) threads_edit = !threads_edit;
+    if (sim_threads != game.sim_threads) {
+        game.sim_threads = sim_threads;
+        game.invalidate_netlist();
+    }
+
+    if (game.sim_mode != (SimulationMode)sim_mode) {
+        game.sim_mode = (SimulationMode)sim_mode;
+        game.invalidate_netlist();
+    }
+
     return CheckCollisionPointRec(GetMousePosition(), menu_area);
 }
 
@@ -116,18 +169,26 @@ bool NodeSelectionMenu() {
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
                 
                 {
-                    std::ifstream saveFile;
-                    saveFile.open(open_file_dialog_json());
-
-                    if (!saveFile.is_open()) goto ouside_if;
-
-                    json save;
-                    saveFile >> save;
-                    saveFile.close();
-                    game.nodes.push_back(new FunctionNode(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
-                    auto it = game.nodes.end();
-                    it--;
-                    (*it)->load_JSON(save);
+                    std::string path = open_file_dialog_json();
+                    if (path.empty()) goto ouside_if;
+
+                    FunctionNode* function = new FunctionNode(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera));
+                    function->label = std::filesystem::path(path).stem().string();
+
+                    // a file that was added before shares the definition of its earlier instances
+                    if (std::shared_ptr<FunctionDefinition> definition = game.function_library[path].lock()) {
+                        function->set_definition(definition);
+                    }
+                    else {
+                        std::vector<Node*> body;
+                        if (!NodeNetworkFromFile(path, &body)) {
+                            delete function;
+                            goto ouside_if;
+                        }
+                        function->set_nodes(body);
+                        game.function_library[path] = function->definition;
+                    }
+                    game.add_node(function);
                 }
             }
         ouside_if:
@@ -146,17 +207,11 @@ bool NodeSelectionMenu() {
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
 
                 {
-                    std::ifstream saveFile;
-                    saveFile.open(open_file_dialog_json());
-
-                    if (!saveFile.is_open()) goto ouside_if2;
-
-                    json save;
-                    saveFile >> save;
-                    saveFile.close();
+                    std::string path = open_file_dialog_json();
+                    if (path.empty()) goto ouside_if2;
 
                     std::vector<Node*> subassembly; 
-                    NodeNetworkFromJson(save.at("nodes"), &subassembly);
+                    if (!NodeNetworkFromFile(path, &subassembly)) goto ouside_if2;
 
                     NormalizeNodeNetworkPosTocLocation(subassembly, game.camera.target);
 
@@ -165,6 +220,7 @@ bool NodeSelectionMenu() {
                     }
 
                     game.nodes.insert(game.nodes.end(), subassembly.begin(), subassembly.end());
+                    game.invalidate_netlist();
                 }
             }
         ouside_if2:
@@ -181,7 +237,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "PushButton";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new PushButton(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new PushButton(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -196,7 +252,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "ToggleButton";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new ToggleButton(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new ToggleButton(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -211,7 +267,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "StaticToggleButton";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new StaticToggleButton(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new StaticToggleButton(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -226,7 +282,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "SevenSegmentDisplay";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new SevenSegmentDisplay(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new SevenSegmentDisplay(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -241,7 +297,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "LightBulb";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new LightBulb(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new LightBulb(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -256,7 +312,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateAND";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateAND(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateAND(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -271,7 +327,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateOR";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -286,7 +342,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateNAND";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateNAND(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateNAND(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -301,7 +357,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateNOR";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateNOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateNOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -316,7 +372,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateXOR";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateXOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateXOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -331,7 +387,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateXNOR";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateXNOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateXNOR(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -346,7 +402,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "Bus";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new Bus(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new Bus(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -361,7 +417,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateBUFFER";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateBUFFER(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateBUFFER(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -376,7 +432,7 @@ bool NodeSelectionMenu() {
             curr_el_h = 30;
             const char* label = "GateNOT";
             if (GuiButton(Rectangle{ menu_area.x + panelScroll.x, menu_area.y + panelScroll.y + current_depth, content_w, curr_el_h }, label)) {
-                game.nodes.push_back(new GateNOT(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
+                game.add_node(new GateNOT(&game.nodes, GetScreenToWorld2D({ game.screenWidth / 2.0f, game.screenHeight / 2.0f }, game.camera)));
             }
             current_depth += curr_el_h;
         }
@@ -0,0 +1,397 @@
+// Runs a saved circuit without opening a window, for CI and benchmarking on build hosts.
+//
+//   Headless <save.json|save.lgsb> [--ticks N] [--mode graph|compiled|event|parallel|levelized] [--threads N]
+//            [--parallel-min N] [--stimulus file.json] [--batch] [--trace] [--dump out.json] [--no-flatten]
+//            [--tables] [--profile out.csv|out.json] [--activity] [--vcd out.vcd] [--expect expected.json]
+//
+// The stimulus file sets input nodes, addressed by label, before the given ticks. An array sets
+// the outputs of a node one by one, a single value sets all of them:
+//   { "events": [ { "tick": 0, "set": { "A": true, "Keys": [1, 0, 1] } } ] }
+// With --batch it holds independent vectors instead, each one is run for --ticks ticks from the
+// saved state by the bit-parallel batch simulator. Inputs are addressed by the names it reports,
+// "label" or "label[pin]" for nodes with several outputs:
+//   { "vectors": [ { "A": 1, "B": 0 }, { "A": 1, "B": 1 } ] }
+//
+// --parallel-min sets the signals a netlist needs before parallel mode uses the threads, so small
+// circuits can be run on them in tests.
+// --profile times the node steps of the run and writes them per node and per type, see Profiler.
+// --activity counts the signal toggles of the run, the totals are printed and the toggles and duty
+// cycle of every top level output over the last ActivityStats::window ticks go into the dump.
+// --vcd records the outputs of every node as a waveform, see Game::start_waveform. The batch
+// simulator has no single waveform, --vcd can't be used with --batch.
+// --expect compares the "outputs", "trace" and "vectors" of a dump written by an earlier run with
+// the ones of this run and fails if any of them differ, for regression runs.
+
+#include "main_game.h"
+#include "batch_simulator.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <map>
+#include <string>
+#include <cstring>
+#include <charconv>
+#include <optional>
+
+struct HeadlessOptions {
+    std::string save_path;
+    std::string stimulus_path;
+    std::string dump_path;
+    std::string profile_path;
+    std::string vcd_path;
+    std::string expect_path;
+    size_t ticks = 1;
+    SimulationMode mode = COMPILED;
+    int threads = 0;
+    // unset keeps the default of Game
+    std::optional<size_t> parallel_min;
+    bool batch = false;
+    bool trace = false;
+    bool flatten = true;
+    bool tables = false;
+    bool activity = false;
+};
+
+static void print_usage()
+{
+    std::cerr << "usage: Headless <save.json|save.lgsb> [--ticks N] [--mode graph|compiled|event|parallel|levelized] [--threads N]\n"
+                 "                [--parallel-min N] [--stimulus file.json] [--batch] [--trace] [--dump out.json] [--no-flatten]\n"
+                 "                [--tables] [--profile out.csv|out.json] [--activity] [--vcd out.vcd] [--expect expected.json]\n";
+}
+
+// the whole of text as a number, false for anything else including a sign on an unsigned value
+template <typename T>
+static bool parse_number(const char* text, T& value)
+{
+    const char* end = text + std::strlen(text);
+    auto [last, error] = std::from_chars(text, end, value);
+    return error == std::errc() && last == end;
+}
+
+static bool parse_args(int argc, char** argv, HeadlessOptions& options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        auto number = [&](auto& value) {
+            if (parse_number(argv[++i], value)) return true;
+            std::cerr << "Invalid value for " << arg << ": " << argv[i] << "\n";
+            return false;
+        };
+
+        if (arg == "--ticks" && has_value) {
+            if (!number(options.ticks)) return false;
+        }
+        else if (arg == "--threads" && has_value) {
+            if (!number(options.threads)) return false;
+        }
+        else if (arg == "--parallel-min" && has_value) {
+            size_t parallel_min;
+            if (!number(parallel_min)) return false;
+            options.parallel_min = parallel_min;
+        }
+        else if (arg == "--stimulus" && has_value) options.stimulus_path = argv[++i];
+        else if (arg == "--dump" && has_value) options.dump_path = argv[++i];
+        else if (arg == "--profile" && has_value) options.profile_path = argv[++i];
+        else if (arg == "--vcd" && has_value) options.vcd_path = argv[++i];
+        else if (arg == "--expect" && has_value) options.expect_path = argv[++i];
+        else if (arg == "--batch") options.batch = true;
+        else if (arg == "--trace") options.trace = true;
+        else if (arg == "--no-flatten") options.flatten = false;
+        else if (arg == "--tables") options.tables = true;
+        else if (arg == "--activity") options.activity = true;
+        else if (arg == "--mode" && has_value) {
+            std::string mode = argv[++i];
+            if (mode == "graph") options.mode = GRAPH;
+            else if (mode == "compiled") options.mode = COMPILED;
+            else if (mode == "event") options.mode = EVENT;
+            else if (mode == "parallel") options.mode = PARALLEL;
+            else if (mode == "levelized") options.mode = LEVELIZED;
+            else {
+                std::cerr << "Unknown mode: " << mode << "\n";
+                return false;
+            }
+        }
+        else if (arg.rfind("--", 0) != 0 && options.save_path.empty()) options.save_path = arg;
+        else {
+            std::cerr << "Unknown argument: " << arg << "\n";
+            return false;
+        }
+    }
+    if (options.batch && !options.vcd_path.empty()) {
+        std::cerr << "--vcd can't be used with --batch\n";
+        return false;
+    }
+    return !options.save_path.empty();
+}
+
+static bool read_json(const std::string& path, json& out)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Unable to open " << path << "\n";
+        return false;
+    }
+    try {
+        file >> out;
+    }
+    catch (const json::exception& e) {
+        std::cerr << "JSON parsing error in " << path << ": " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool json_bit(const json& value)
+{
+    if (value.is_boolean()) return value.get<bool>();
+    if (value.is_number()) return value.get<double>() != 0;
+    return false;
+}
+
+static bool set_input(std::vector<Node*>& nodes, const std::string& label, const json& value)
+{
+    bool found = false;
+    for (Node* node : nodes) {
+        if (!node->isInput() || node->label != label) continue;
+        for (size_t i = 0; i < node->outputs.size(); i++) {
+            if (value.is_array()) node->outputs[i].state = i < value.size() && json_bit(value[i]);
+            else node->outputs[i].state = json_bit(value);
+        }
+        node->has_changed = true;
+        found = true;
+    }
+    if (!found) std::cerr << "Stimulus error: no input node labelled \"" << label << "\"\n";
+    return found;
+}
+
+static bool is_output_node(const Node* node)
+{
+    return node->get_type() == "LightBulb" || node->get_type() == "SevenSegmentDisplay";
+}
+
+// state of every input of an output node, first input first
+static std::string output_bits(const Node* node)
+{
+    std::string bits;
+    for (const Input_connector& in : node->inputs) {
+        bits += in.target && in.target->state ? '1' : '0';
+    }
+    return bits;
+}
+
+static json outputs_to_json(const std::vector<Node*>& nodes)
+{
+    json outputs = json::array();
+    for (const Node* node : nodes) {
+        if (is_output_node(node)) outputs.push_back({ {"label", node->label}, {"state", output_bits(node)} });
+    }
+    return outputs;
+}
+
+static void print_outputs(const std::vector<Node*>& nodes)
+{
+    for (const Node* node : nodes) {
+        if (is_output_node(node)) std::cout << node->label << ": " << output_bits(node) << "\n";
+    }
+}
+
+static json activity_to_json(const ActivityStats& activity)
+{
+    json connectors = json::array();
+    for (auto& [conn, signal] : activity.connectors()) {
+        connectors.push_back({
+            {"label", conn->host->label},
+            {"type", conn->host->get_type()},
+            {"pin", conn->index},
+            {"toggles", activity.toggles(signal)},
+            {"duty_cycle", activity.duty_cycle(signal)}
+        });
+    }
+    return {
+        {"signals", activity.size()},
+        {"total_ticks", activity.total_ticks},
+        {"total_toggles", activity.total_toggles},
+        {"window_ticks", activity.window_ticks()},
+        {"window_toggles", activity.window_toggles()},
+        {"toggle_rate", activity.toggle_rate()},
+        {"connectors", connectors}
+    };
+}
+
+// prints the sections of the expected dump that differ from this run and their first difference
+static bool check_expected(const json& expected, const json& dump)
+{
+    bool matches = true;
+    for (const char* key : { "outputs", "trace", "vectors" }) {
+        if (!expected.contains(key)) continue;
+        if (!dump.contains(key)) {
+            std::cerr << "Expected " << key << " but the run has none, pass the options it was recorded with\n";
+            matches = false;
+            continue;
+        }
+        const json& want = expected.at(key);
+        const json& got = dump.at(key);
+        if (want == got) continue;
+        matches = false;
+        std::cerr << "Mismatch in " << key;
+        for (size_t i = 0; i < std::min(want.size(), got.size()); i++) {
+            if (want[i] == got[i]) continue;
+            std::cerr << " at " << i << ": expected " << want[i].dump() << ", got " << got[i].dump();
+            break;
+        }
+        if (want.size() != got.size()) std::cerr << ", expected " << want.size() << " entries, got " << got.size();
+        std::cerr << "\n";
+    }
+    return matches;
+}
+
+static int run_batch(Game& game, const HeadlessOptions& options, const json& stimulus, json& dump)
+{
+    BatchSimulator sim;
+    if (!sim.compile(game.nodes, options.flatten)) return 1;
+
+    std::map<std::string, size_t> column;
+    for (size_t i = 0; i < sim.input_names().size(); i++) column[sim.input_names()[i]] = i;
+
+    std::vector<std::vector<bool>> vectors;
+    if (stimulus.contains("vectors")) {
+        for (const json& vec : stimulus.at("vectors")) {
+            std::vector<bool> row(column.size());
+            for (auto& [name, value] : vec.items()) {
+                auto it = column.find(name);
+                if (it == column.end()) {
+                    std::cerr << "Stimulus error: no batch input named \"" << name << "\"\n";
+                    return 1;
+                }
+                row[it->second] = json_bit(value);
+            }
+            vectors.push_back(row);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<bool>> results = sim.run(vectors, options.ticks);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "ran " << vectors.size() << " vectors for " << options.ticks << " ticks in " << seconds << " s\n";
+
+    json rows = json::array();
+    for (size_t v = 0; v < results.size(); v++) {
+        json row = json::object();
+        std::cout << "vector " << v << ":";
+        for (size_t o = 0; o < results[v].size(); o++) {
+            std::cout << " " << sim.output_names()[o] << "=" << results[v][o];
+            row[sim.output_names()[o]] = bool(results[v][o]);
+        }
+        std::cout << "\n";
+        rows.push_back(row);
+    }
+    dump["vectors"] = rows;
+    return 0;
+}
+
+static int run_ticks(Game& game, const HeadlessOptions& options, const json& stimulus, json& dump)
+{
+    // tick index to the "set" objects applied before it
+    std::map<size_t, std::vector<const json*>> events;
+    if (stimulus.contains("events")) {
+        for (const json& event : stimulus.at("events")) {
+            size_t tick = event.value("tick", size_t(0));
+            if (tick >= options.ticks) {
+                std::cerr << "Stimulus warning: event at tick " << tick << " is past the end of the run\n";
+                continue;
+            }
+            if (event.contains("set")) events[tick].push_back(&event.at("set"));
+        }
+    }
+
+    json trace = json::array();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < options.ticks; t++) {
+        auto it = events.find(t);
+        if (it != events.end()) {
+            for (const json* set : it->second) {
+                for (auto& [label, value] : set->items()) {
+                    if (!set_input(game.nodes, label, value)) return 1;
+                }
+            }
+        }
+
+        game.pretick();
+        game.tick();
+
+        if (options.trace) {
+            game.sync_netlist_to_editor();
+            std::cout << "tick " << t << "\n";
+            print_outputs(game.nodes);
+            trace.push_back(outputs_to_json(game.nodes));
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "ran " << options.ticks << " ticks in " << seconds << " s (" << options.ticks / seconds << " ticks/s)\n";
+
+    game.sync_netlist_to_editor();
+    if (!options.trace) print_outputs(game.nodes);
+
+    dump["outputs"] = outputs_to_json(game.nodes);
+    if (options.trace) dump["trace"] = trace;
+    if (options.activity) {
+        const ActivityStats& activity = game.activity;
+        std::cerr << activity.total_toggles << " toggles of " << activity.size() << " signals, "
+                  << double(activity.total_toggles) / std::max<uint64_t>(activity.total_ticks, 1) << " per tick\n";
+        dump["activity"] = activity_to_json(activity);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    HeadlessOptions options;
+    if (!parse_args(argc, argv, options)) {
+        print_usage();
+        return 2;
+    }
+
+    if (!std::filesystem::exists(options.save_path)) {
+        std::cerr << "No such save file: " << options.save_path << "\n";
+        return 1;
+    }
+
+    json stimulus = json::object();
+    if (!options.stimulus_path.empty() && !read_json(options.stimulus_path, stimulus)) return 1;
+    json expected;
+    if (!options.expect_path.empty() && !read_json(options.expect_path, expected)) return 1;
+
+    Game& game = Game::getInstance();
+    if (!game.load(options.save_path)) return 1;
+
+    game.sim_mode = options.mode;
+    game.sim_on_thread = false;
+    game.flatten_functions = options.flatten;
+    game.function_tables = options.tables;
+    if (options.threads > 0) game.sim_threads = options.threads;
+    if (options.parallel_min) game.parallel_min_signals = *options.parallel_min;
+    game.profiler.enabled = !options.profile_path.empty();
+    game.activity.enabled = options.activity;
+    if (!options.vcd_path.empty() && !game.start_waveform(options.vcd_path)) return 1;
+
+    json dump = { {"save", options.save_path}, {"ticks", options.ticks} };
+    int retval = options.batch ? run_batch(game, options, stimulus, dump) : run_ticks(game, options, stimulus, dump);
+    if (retval != 0) return retval;
+
+    game.stop_waveform();
+    if (!options.profile_path.empty() && !game.profiler.save(options.profile_path)) return 1;
+
+    if (!options.dump_path.empty()) {
+        std::ofstream out(options.dump_path);
+        if (!out.is_open()) {
+            std::cerr << "Unable to open " << options.dump_path << "\n";
+            return 1;
+        }
+        out << dump.dump(4);
+    }
+    if (!options.expect_path.empty() && !check_expected(expected, dump)) return 1;
+    return 0;
+}
@@ -3,12 +3,19 @@
 #include "vector_tools.h"
 #include <fstream>
 #include <cassert>
+#include <cstdio>
 
 #include <filesystem>
 #include <iostream>
 
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
 #include "vector_tools.h"
+#include "binary_save.h"
+#include "sax_loader.h"
+#include "mapped_file.h"
 #include "raygui.h"
 
 Node::Node(std::vector<Node*> * container, Vector2 pos, Vector2 size, Color color, std::vector<Input_connector> in, std::vector<Output_connector> out) : container(container), size(size), color(color), is_selected(false), inputs(in), outputs(out), pos(pos)
@@ -23,13 +30,25 @@ Node::Node(const Node* base) : container(base->container), is_selected(false), p
 {
     reserve_outputs();
     for (size_t i = 0; i < base->inputs.size(); ++i) {
-        inputs.push_back(Input_connector(this, i, base->inputs[i].target));
+        inputs.push_back(Input_connector(this, i));
+        inputs.back().connect(base->inputs[i].target);
     }
     for (size_t i = 0; i < base->outputs.size(); ++i) {
         outputs.push_back(Output_connector(this, i, base->outputs[i].state));
     }
 }
 
+Node::~Node()
+{
+    Game::getInstance().profiler.forget(this);
+    for (Input_connector& input : inputs) {
+        input.disconnect();
+    }
+    for (Output_connector& output : outputs) {
+        output.disconnect_readers();
+    }
+}
+
 void Game::draw() {
     // Draw world
     screenWidth = GetScreenWidth();
@@ -38,12 +57,34 @@ void Game::draw() {
     BeginDrawing();
     ClearBackground(BLACK);
 
+    sync_netlist_to_editor();
+
     BeginMode2D(camera);
 
     for (Node* node : nodes) {
         node->draw();
     }
 
+    if (profiler.enabled) {
+        for (Node* node : nodes) {
+            float heat = profiler.heat(node);
+            if (heat > 0) DrawRectangleRec(Rectangle{ node->pos.x - node->size.x / 2, node->pos.y - node->size.y / 2, node->size.x, node->size.y }, Fade(RED, 0.15f + 0.6f * heat));
+        }
+    }
+
+    if (activity.enabled && !activity.empty()) {
+        // nodes shaded by their toggles in the window relative to the busiest node
+        std::unordered_map<const Node*, uint64_t> toggles = activity.toggles_by_node();
+        uint64_t most = 0;
+        for (auto& [node, count] : toggles) most = std::max(most, count);
+        for (Node* node : nodes) {
+            auto it = toggles.find(node);
+            if (it == toggles.end() || it->second == 0) continue;
+            float heat = float(double(it->second) / double(most));
+            DrawRectangleRec(Rectangle{ node->pos.x - node->size.x / 2, node->pos.y - node->size.y / 2, node->size.x, node->size.y }, Fade(ORANGE, 0.15f + 0.6f * heat));
+        }
+    }
+
     if (area_selected) {
         Rectangle area = RectFrom2Points(GetScreenToWorld2D(GetMousePosition(), camera), first_corner);
         DrawRectangleRec(area, Fade(GREEN, 0.05f));
@@ -52,6 +93,11 @@ void Game::draw() {
     EndMode2D();
 
     DrawText(num_toString(real_sim_hz, 1).c_str(), 10, 100, 20, WHITE);
+    if (activity.enabled && activity.window_ticks() > 0) {
+        std::string toggles = num_toString(double(activity.window_toggles()) / activity.window_ticks(), 1) + " toggles/tick, "
+            + num_toString(100 * activity.toggle_rate(), 2) + "% of " + std::to_string(activity.size()) + " signals";
+        DrawText(toggles.c_str(), 10, 125, 20, WHITE);
+    }
 
 
     hovering_above_gui = false;
@@ -75,6 +121,31 @@ void Game::draw() {
 
 void Game::pretick()
 {
+    step_mode = sim_mode;
+    if (step_mode != GRAPH) {
+        if (!netlist_valid) {
+            netlist.compile(nodes, flatten_functions);
+            netlist_valid = true;
+        }
+        netlist.sync_from_editor();
+        if (step_mode == EVENT)
+            netlist.pretick_events();
+        else if (step_mode == LEVELIZED)
+            netlist.pretick_levelized();
+        else if (WorkStealingPool* pool = parallel_pool())
+            netlist.pretick_parallel(*pool);
+        else
+            netlist.pretick();
+        return;
+    }
+
+    begin_bus_phase(&nodes);
+    if (profiler.enabled) {
+        for (Node* node : nodes) {
+            profiler.pretick(node);
+        }
+        return;
+    }
     for (Node* node : nodes) {
         node->pretick();
     }
@@ -82,9 +153,255 @@ void Game::pretick()
 
 void Game::tick()
 {
+    if (step_mode != GRAPH) {
+        // The pretick of this step ran on a netlist an edit has invalidated since, it may step
+        // deleted nodes and the editor graph was never preticked. The step is dropped.
+        if (!netlist_valid) {
+            if (!step_dropped_logged) std::cout << "The circuit changed during a compiled step, the step was dropped\n";
+            step_dropped_logged = true;
+        }
+        else if (step_mode == EVENT)
+            netlist.tick_events();
+        else if (step_mode == LEVELIZED)
+            netlist.tick_levelized();
+        else
+            netlist.tick();
+    }
+    else if (profiler.enabled) {
+        for (Node* node : nodes) {
+            profiler.tick(node);
+        }
+    }
+    else {
+        for (Node* node : nodes) {
+            node->tick();
+        }
+    }
+
+    if (activity.enabled) sample_activity();
+    if (waveform.recording()) waveform.sample(waveform_state());
+}
+
+void Game::sample_activity()
+{
+    if (sim_mode != GRAPH) {
+        if (!netlist_valid) return;
+        if (!activity_valid || activity_mode != sim_mode) {
+            const auto& bindings = netlist.editor_bindings();
+            activity.reset(netlist.signal_count(), std::vector<std::pair<const Output_connector*, uint32_t>>(bindings.begin(), bindings.end()));
+            activity_valid = true;
+            activity_mode = sim_mode;
+        }
+        activity.sample(netlist.state_words());
+        return;
+    }
+
+    // the graph keeps its state in the connectors, the top level outputs are packed in node order
+    if (!activity_valid || activity_mode != sim_mode) {
+        std::vector<std::pair<const Output_connector*, uint32_t>> connectors;
+        for (Node* node : nodes) {
+            for (Output_connector& output : node->outputs) {
+                connectors.push_back({ &output, uint32_t(connectors.size()) });
+            }
+        }
+        size_t count = connectors.size();
+        activity.reset(count, std::move(connectors));
+        activity_valid = true;
+        activity_mode = sim_mode;
+    }
+    const auto& connectors = activity.connectors();
+    activity_words.assign((connectors.size() + 63) / 64, 0);
+    for (size_t i = 0; i < connectors.size(); i++) {
+        activity_words[i >> 6] |= uint64_t(connectors[i].first->state) << (i & 63);
+    }
+    activity.sample(activity_words.data());
+}
+
+// the node's label, or its type without one, with a number appended if a sibling has the same name
+static std::string unique_wire_name(std::unordered_set<std::string>& taken, const Node* node)
+{
+    std::string name = node->label.empty() ? node->get_type() : node->label;
+    std::string unique = name;
+    for (int n = 2; !taken.insert(unique).second; n++) unique = name + "_" + std::to_string(n);
+    return unique;
+}
+
+bool Game::start_waveform(const std::string& path)
+{
+    stop_waveform();
+    sim_thread.stop();
+    waveform_compiled = sim_mode != GRAPH;
+    waveform_sources.clear();
+    if (waveform_compiled && !netlist_valid) {
+        netlist.compile(nodes, flatten_functions);
+        netlist_valid = true;
+    }
+
+    std::unordered_map<const Output_connector*, uint32_t> bound;
+    std::unordered_map<const FunctionNode*, const FlatInstance*> flattened;
+    if (waveform_compiled) {
+        for (auto& [output, signal] : netlist.editor_bindings()) bound[output] = signal;
+        for (const FlatInstance& flat : netlist.flattened_instances()) flattened[flat.instance] = &flat;
+    }
+
+    std::vector<VcdSignal> signals;
+    std::vector<std::string> scope{ "circuit" };
+    // pin is the index of the wire among the node's, -1 for nodes with one
+    auto add_output = [&](const std::string& name, int pin, const Output_connector* output) {
+        if (!waveform_compiled) {
+            signals.push_back({ scope, name, uint32_t(waveform_sources.size()), pin });
+            waveform_sources.push_back({ output, nullptr, 0 });
+            return;
+        }
+        auto it = bound.find(output);
+        if (it != bound.end()) signals.push_back({ scope, name, it->second, pin });
+    };
+    // the outputs in the body of a top level instance, i walks its state in FunctionDefinition::store_state order
+    std::function<void(const FunctionDefinition&, const FunctionNode*, const FlatInstance*, size_t&)> add_body =
+        [&](const FunctionDefinition& body, const FunctionNode* instance, const FlatInstance* flat, size_t& i) {
+        std::unordered_set<std::string> taken;
+        for (const Node* node : body.nodes) {
+            i++; // has_changed
+            std::string name = unique_wire_name(taken, node);
+            for (size_t pin = 0; pin < node->outputs.size(); pin++, i++) {
+                int index = node->outputs.size() > 1 ? int(pin) : -1;
+                if (!waveform_compiled) {
+                    signals.push_back({ scope, name, uint32_t(waveform_sources.size()), index });
+                    waveform_sources.push_back({ nullptr, instance, uint32_t(i) });
+                }
+                else if (flat->state_signals[i] != Netlist::no_signal) {
+                    signals.push_back({ scope, name, flat->state_signals[i], index });
+                }
+            }
+            if (const FunctionNode* function = dynamic_cast<const FunctionNode*>(node)) {
+                scope.push_back(name);
+                add_body(*function->definition, instance, flat, i);
+                scope.pop_back();
+            }
+        }
+    };
+
+    bool any_selected = std::any_of(nodes.begin(), nodes.end(), [](const Node* node) { return node->is_selected; });
+    std::unordered_set<std::string> taken;
     for (Node* node : nodes) {
-        node->tick();
+        if (any_selected && !node->is_selected) continue;
+        std::string name = unique_wire_name(taken, node);
+        // nodes without outputs like lamps show what drives them
+        for (size_t pin = 0; node->outputs.empty() && pin < node->inputs.size(); pin++) {
+            if (node->inputs[pin].target)
+                add_output(name, node->inputs.size() > 1 ? int(pin) : -1, node->inputs[pin].target);
+        }
+        for (size_t pin = 0; pin < node->outputs.size(); pin++) {
+            add_output(name, node->outputs.size() > 1 ? int(pin) : -1, &node->outputs[pin]);
+        }
+
+        FunctionNode* function = dynamic_cast<FunctionNode*>(node);
+        if (!function) continue;
+        const FlatInstance* flat = nullptr;
+        if (waveform_compiled) {
+            // the body of an opaque function isn't part of the netlist
+            auto it = flattened.find(function);
+            if (it == flattened.end()) continue;
+            flat = it->second;
+        }
+        scope.push_back(name);
+        size_t i = 0;
+        add_body(*function->definition, function, flat, i);
+        scope.pop_back();
     }
+
+    size_t bit_count = waveform_compiled ? netlist.signal_count() : waveform_sources.size();
+    if (!waveform.open(path, signals, bit_count, waveform_state())) return false;
+    std::cout << "Recording " << signals.size() << " wires to " << path << "\n";
+    return true;
+}
+
+void Game::stop_waveform()
+{
+    if (!waveform.recording()) return;
+    // the simulation thread samples the recorder
+    sim_thread.stop();
+    uint64_t ticks = waveform.ticks();
+    waveform.close();
+    std::cout << "Recorded " << ticks << " ticks\n";
+}
+
+const uint64_t* Game::waveform_state()
+{
+    if (waveform_compiled) return netlist.state_words();
+
+    waveform_words.assign((waveform_sources.size() + 63) / 64, 0);
+    for (size_t i = 0; i < waveform_sources.size(); i++) {
+        const WaveformSource& source = waveform_sources[i];
+        bool state = source.output ? source.output->state : bool(source.function->state[source.bit]);
+        waveform_words[i >> 6] |= uint64_t(state) << (i & 63);
+    }
+    return waveform_words.data();
+}
+
+WorkStealingPool* Game::parallel_pool()
+{
+    if (sim_mode != PARALLEL || sim_threads <= 1 || netlist.signal_count() < parallel_min_signals)
+        return nullptr;
+    if (!sim_pool || sim_pool->thread_count() != size_t(sim_threads))
+        sim_pool = std::make_unique<WorkStealingPool>(sim_threads);
+    return sim_pool.get();
+}
+
+bool Game::update_sim_thread(uint64_t& ticks)
+{
+    ticks = 0;
+    if (!sim_on_thread || sim_mode == GRAPH) {
+        sim_thread.stop();
+        return false;
+    }
+
+    if (!netlist_valid) {
+        sim_thread.stop();
+        netlist.compile(nodes, flatten_functions);
+        netlist_valid = true;
+    }
+    // nodes that could not be lowered are stepped through the editor graph, which belongs to this
+    // thread, and the activity statistics sample the netlist after every tick
+    if (netlist.opaque_count() != 0 || activity.enabled)
+        return false;
+
+    sim_thread.set_rate(targ_sim_hz, warp);
+    if (!sim_thread.running()) {
+        if (sim_mode == EVENT) {
+            sim_thread.start(netlist, [this] {
+                netlist.pretick_events();
+                netlist.tick_events();
+                if (waveform.recording()) waveform.sample(netlist.state_words());
+            });
+        }
+        else if (sim_mode == LEVELIZED) {
+            sim_thread.start(netlist, [this] {
+                netlist.pretick_levelized();
+                netlist.tick_levelized();
+                if (waveform.recording()) waveform.sample(netlist.state_words());
+            });
+        }
+        else {
+            WorkStealingPool* pool = parallel_pool();
+            sim_thread.start(netlist, [this, pool] {
+                if (pool) netlist.pretick_parallel(*pool);
+                else netlist.pretick();
+                netlist.tick();
+                if (waveform.recording()) waveform.sample(netlist.state_words());
+            });
+        }
+    }
+
+    sim_thread.sync_editor();
+    ticks = sim_thread.take_ticks();
+    return true;
+}
+
+void Game::sync_netlist_to_editor()
+{
+    if (sim_mode != GRAPH && netlist_valid && !sim_thread.running())
+        netlist.sync_to_editor();
 }
 
 void Game::unselect_all()
@@ -96,40 +413,28 @@ void Game::unselect_all()
     selected_outputs.clear();
 }
 
+void Game::add_node(Node* node)
+{
+    nodes.push_back(node);
+    invalidate_netlist();
+}
+
 void Game::remove_node(Node* node)
 {
+    invalidate_netlist();
     nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
 
-    for (Node* gate : nodes) {
-        for (Input_connector& inp : gate->inputs) {
-            for (Output_connector& out : node->outputs) {
-                if (inp.target == &out) {
-                    inp.target = nullptr;
-                }
-            }
-
-        }
+    for (Output_connector& out : node->outputs) {
+        out.disconnect_readers();
     }
 }
 
 void Game::delete_selected_nodes() {
+    invalidate_netlist();
 
-    // Delete selected objects and set their pointers to nullptr
+    // Delete selected objects and set their pointers to nullptr, deleting a node disconnects everything reading from it
     for (Node*& node : nodes) {
         if (node != nullptr && node->is_selected) {
-
-            for (Node* gate : nodes) {
-                if (gate == nullptr) continue;
-                for (Input_connector& inp : gate->inputs) {
-                    for (Output_connector& out : node->outputs) {
-                        if (inp.target == &out) {
-                            inp.target = nullptr;
-                        }
-                    }
-
-                }
-            }
-
             delete node;
             node = nullptr;
         }
@@ -151,7 +456,9 @@ void Game::copy_selected_nodes()
     size_t idx = 0;
     for (size_t i = 0; i < nodes.size(); ++i) {
         if (nodes[i]->is_selected) {
+            // the clipboard is a container of its own, a copied bus would drive the live line otherwise
             clipboard.push_back(nodes[i]->copy());
+            clipboard.back()->move_to_container(&clipboard);
             idxs[i] = idx;
             ++idx;
         }
@@ -172,7 +479,7 @@ void Game::copy_selected_nodes()
                 for (size_t j = 0; j < nodes.size(); ++j) {
 
                     if (nodes[j] == input.target->host) {
-                        input.target = &(clipboard[idxs[j]]->outputs[target_idx]);
+                        input.connect(&(clipboard[idxs[j]]->outputs[target_idx]));
                     }
                 }
 
@@ -189,6 +496,8 @@ void Game::paste_nodes()
 
     size_t i = nodes.size();
 
+    invalidate_netlist();
+    for (Node* node : clipboard) node->move_to_container(&nodes);
     nodes.insert(nodes.end(), clipboard.begin(), clipboard.end());
     clipboard.clear();
 
@@ -434,14 +743,15 @@ void Game::handle_input()
                     return a->get_connection_pos().y > b->get_connection_pos().y; // Return true if 'a' should come before 'b'
                     });
 
+                invalidate_netlist();
                 if (selected_outputs.size() > 1) {
                     for (size_t i = 0; i < std::min(selected_inputs.size(), selected_outputs.size()); i++) {
-                        selected_inputs[i]->target = selected_outputs[i];
+                        selected_inputs[i]->connect(selected_outputs[i]);
                     }
                 }
                 else {
                     for (size_t i = 0; i < selected_inputs.size(); i++) {
-                        selected_inputs[i]->target = selected_outputs[0];
+                        selected_inputs[i]->connect(selected_outputs[0]);
                     }
                 }
             }
@@ -449,21 +759,12 @@ void Game::handle_input()
         }
 
         if (IsKeyReleased(KEY_DELETE)) {
+            invalidate_netlist();
             for (auto& input : selected_inputs) {
-                input->target = nullptr;
+                input->disconnect();
             }
-            if (!selected_outputs.empty()) {
-                for (Node* node : nodes) {
-                    for (Input_connector& incon : node->inputs) {
-                        // Check if incon.target is in selected_outputs
-                        for (auto& selected_output : selected_outputs) {
-                            if (incon.target == selected_output) {
-                                incon.target = nullptr;
-                                break; // No need to check other selected_outputs if a match is found
-                            }
-                        }
-                    }
-                }
+            for (auto& output : selected_outputs) {
+                output->disconnect_readers();
             }
         }
 
@@ -514,9 +815,15 @@ void Game::save(std::string filePath)
     std::filesystem::path filepath(filePath);
     std::string filename = filepath.stem().string();
 
+    if (filepath.extension() == ".lgsb") {
+        save_binary(filePath);
+        return;
+    }
+
     json myJson = {
         {"label", filename.c_str()},
         {"camera", camera},
+        {"definitions", FunctionDefinitionsToJson(nodes)},
         {"nodes", json::array()}
     };
 
@@ -540,40 +847,63 @@ void Game::save(std::string filePath)
 
 }
 
+void Game::save_binary(std::string filePath)
+{
+    if (filePath.empty()) {
+        std::cout << "No file path selected\n";
+        return;
+    }
+
+    std::string filename = std::filesystem::path(filePath).stem().string();
+    if (save_binary_file(filePath, filename, camera, nodes))
+        std::cout << "Binary data saved to file: " << filePath << std::endl;
+}
+
 void NodeNetworkFromJson(const json& nodeNetworkJson, std::vector<Node*> * nodes) {
+    // output ids to their connectors, filled as the nodes are created so each input resolves with one lookup
+    std::unordered_map<connector_id_t, Output_connector*> outputs_by_id;
+    size_t duplicate_ids = 0;
+    const size_t first_new = nodes->size();
+
     for (const auto& node : nodeNetworkJson) {
         // Each node is a JSON object where the key is the gate type
         for (auto it = node.begin(); it != node.end(); ++it) {
             std::string nodeType = it.key(); // Get the gate type (e.g., "GateAND")
-            json nodeJson = it.value(); // Get the JSON object representing the node
+            const json& nodeJson = it.value(); // Get the JSON object representing the node
 
             Node* node = NodeFactory::createNode(nodes, nodeType);
             assert(node && "node not created");
             node->load_JSON(nodeJson);
             nodes->push_back(node);
+
+            // the first output with an id wins, like the linear search this replaced
+            for (Output_connector& output : node->outputs) {
+                if (!outputs_by_id.emplace(output.id, &output).second) duplicate_ids++;
+            }
         }
     }
 
-    for (Node* node : *nodes) {
-        for (Input_connector& input : node->inputs) {
-
-            bool found = false;
-            uid_t id = input.target_id;
-            if (id) {
-                for (Node* node2 : *nodes) {
-                    if (found) break;
-                    for (Output_connector& output : node2->outputs) {
-                        if (output.id == id) {
-                            input.target = &output;
-                            found = true;
-                            break;
-                        }
-                    }
-                }
-            }
+    size_t dangling_ids = 0;
+    for (size_t i = first_new; i < nodes->size(); i++) {
+        for (Input_connector& input : (*nodes)[i]->inputs) {
+            connector_id_t id = input.target_id;
+            if (!id) continue;
 
+            auto found = outputs_by_id.find(id);
+            if (found != outputs_by_id.end()) input.connect(found->second);
+            else dangling_ids++;
         }
     }
+
+    ReportConnectorIdProblems(duplicate_ids, dangling_ids);
+}
+
+void ReportConnectorIdProblems(size_t duplicate_ids, size_t dangling_ids)
+{
+    if (duplicate_ids)
+        std::cerr << "JSON loading warning: " << duplicate_ids << " outputs share an id with an earlier output, inputs connect to the first one\n";
+    if (dangling_ids)
+        std::cerr << "JSON loading warning: " << dangling_ids << " inputs refer to output ids that don't exist and were left unconnected\n";
 }
 
 void NormalizeNodeNetworkPosTocLocation(std::vector<Node*>& nodes, Vector2 targpos)
@@ -585,25 +915,47 @@ void NormalizeNodeNetworkPosTocLocation(std::vector<Node*>& nodes, Vector2 targp
     }
 }
 
-void Game::load(std::string filePath)
+bool NodeNetworkFromFile(const std::string& filePath, std::vector<Node*> * nodes, Camera2D* camera)
+{
+    // both formats are parsed straight out of the mapping, a 500 MB save never passes through a stream
+    MappedFile mapped;
+    if (mapped.open(filePath)) {
+        if (is_binary_save(mapped.data(), mapped.size()))
+            return load_binary_save(mapped.data(), mapped.size(), camera, nodes);
+        return NodeNetworkFromJsonBuffer(mapped.data(), mapped.size(), nodes, camera);
+    }
+
+    // files that can't be mapped, empty ones included, are streamed
+    std::ifstream saveFile(filePath, std::ios::binary);
+    if (!saveFile.is_open()) {
+        std::cerr << "Unable to open file: " << filePath << std::endl;
+        return false;
+    }
+    return NodeNetworkFromJsonStream(saveFile, nodes, camera);
+}
+
+bool Game::load(std::string filePath)
 {
     if (filePath.empty()) {
         std::cout << "No file path selected\n";
-        return;
+        return false;
     }
 
-    std::ifstream saveFile;
-    saveFile.open(filePath);
-    assert(saveFile.is_open() && "Unable to open file");
+    // the current circuit stays as it is unless the whole file loads
+    std::vector<Node*> loaded;
+    Camera2D loaded_camera = camera;
+    if (!NodeNetworkFromFile(filePath, &loaded, &loaded_camera)) return false;
 
-    json save;
-    saveFile >> save;
-    saveFile.close();
-    
-    nodes.clear();
-    NodeNetworkFromJson(save["nodes"], &nodes);
-    if (save.contains("camera"))
-        camera = save.at("camera").get<Camera2D>();
+    // deleting the replaced nodes takes their buses out of the groups of this container, the loaded
+    // buses would share lines with them otherwise
+    invalidate_netlist();
+    selected_inputs.clear();
+    selected_outputs.clear();
+    for (Node* node : nodes) delete node;
+    for (Node* node : loaded) node->move_to_container(&nodes);
+    nodes.swap(loaded);
+    camera = loaded_camera;
+    return true;
 }
 
 void Node::draw()
@@ -661,7 +1013,7 @@ bool Node::show_node_editor()
     static bool TextBoxNodeLabelEditMode = false;
     const static size_t buffersize = 256;
     char TextBoxNodeLabel[256] = "";
-    strcpy_s(TextBoxNodeLabel, buffersize, label.c_str());
+    snprintf(TextBoxNodeLabel, buffersize, "%s", label.c_str());
 
     GuiPanel(area, "Node Settings");
 
@@ -677,8 +1029,9 @@ bool Node::show_node_editor()
         if (GuiTextBox(Rectangle{ current_x, Pos.y + current_depth, Pos.x + margin + content_w - current_x, 32 }, TextBoxNodeLabel, buffersize, TextBoxNodeLabelEditMode)) {
             TextBoxNodeLabelEditMode = !TextBoxNodeLabelEditMode;
         }
-        if (label.c_str() != TextBoxNodeLabel) {
+        if (label != TextBoxNodeLabel) {
             change_label(TextBoxNodeLabel);
+            game.invalidate_netlist();
         }
         current_depth += curr_el_h;
     }
@@ -696,10 +1049,16 @@ bool Node::show_node_editor()
         GuiLabel(Rectangle{ current_x, Pos.y + current_depth, 64, 32 }, "Connectors:");
         current_x += 64 + margin;
 
-        if (GuiButton(Rectangle{ current_x, Pos.y + current_depth, 32, 32 }, "#121#")) add_input();
+        if (GuiButton(Rectangle{ current_x, Pos.y + current_depth, 32, 32 }, "#121#")) {
+            add_input();
+            game.invalidate_netlist();
+        }
         current_x += 32 + margin;
 
-        if (GuiButton(Rectangle{ current_x, Pos.y + current_depth, 32, 32 }, "#120#")) remove_input();
+        if (GuiButton(Rectangle{ current_x, Pos.y + current_depth, 32, 32 }, "#120#")) {
+            remove_input();
+            game.invalidate_netlist();
+        }
         current_x += 32 + margin;
 
         current_depth += curr_el_h;
@@ -1090,6 +1449,9 @@ void Node::load_JSON(const json& nodeJson) {
         size.x = nodeJson.at("size.x").get<float>();
         size.y = nodeJson.at("size.y").get<float>();
 
+        for (Input_connector& input : inputs) {
+            input.disconnect();
+        }
         inputs.clear();
         {
             size_t i = 0;
@@ -1100,6 +1462,9 @@ void Node::load_JSON(const json& nodeJson) {
             }
         }
 
+        for (Output_connector& output : outputs) {
+            output.disconnect_readers();
+        }
         outputs.clear();
         {
             size_t i = 0;
@@ -1145,6 +1510,14 @@ void Output_connector::draw() const
     DrawLineEx(startPos, endPos, lineThick, color);
 }
 
+void Output_connector::disconnect_readers()
+{
+    for (const InputRef& reader : readers) {
+        reader.host->inputs[reader.index].target = nullptr;
+    }
+    readers.clear();
+}
+
 json Output_connector::to_JSON() const {
     return json{ 
         {"Output_connector", json::object({  {"id", id}, {"state", state}})}
@@ -1184,50 +1557,79 @@ void Input_connector::draw() const
     }
 }
 
+void Input_connector::connect(Output_connector* new_target)
+{
+    if (target == new_target) return;
+
+    if (target) {
+        std::vector<InputRef>& readers = target->readers;
+        for (size_t i = 0; i < readers.size(); i++) {
+            if (readers[i].host == host && readers[i].index == index) {
+                readers[i] = readers.back();
+                readers.pop_back();
+                break;
+            }
+        }
+    }
+
+    target = new_target;
+    if (target) target->readers.push_back({ host, index });
+}
+
 json Input_connector::to_JSON() const {
     return json{
         {"Input_connector", json::object({  {"target", target ? target->id : 0}})}
     };
 }
 
-FunctionNode::FunctionNode(const FunctionNode* base): Node(base), is_single_tick(base->is_single_tick), is_cyclic_val(base->is_cyclic_val)
+// definitions by id, so loading a save whose definitions are alive shares them instead of loading them again
+static std::unordered_map<connector_id_t, std::weak_ptr<FunctionDefinition>>& function_definitions()
 {
-    nodes.clear();
-    size_t* idxs = new size_t[base->nodes.size()];
-
-    size_t idx = 0;
-    for (size_t i = 0; i < base->nodes.size(); ++i) {
-        nodes.push_back(base->nodes[i]->copy());
-        idxs[i] = idx;
-        ++idx;
-    }
-
-    for (size_t i = 0; i < nodes.size(); ++i) {
-
-        for (Input_connector& input : nodes[i]->inputs) {
-            if (input.target) {
+    static std::unordered_map<connector_id_t, std::weak_ptr<FunctionDefinition>> definitions;
+    return definitions;
+}
 
-                size_t target_idx = -1;
-                for (size_t p = 0; p < input.target->host->outputs.size(); ++p) {
-                    if (&input.target->host->outputs[p] == input.target) target_idx = p;
-                }
+FunctionDefinition::~FunctionDefinition()
+{
+    auto& definitions = function_definitions();
+    auto it = definitions.find(id);
+    if (it != definitions.end() && it->second.expired()) definitions.erase(it);
 
-                assert(target_idx != -1);
+    for (Node* node : nodes) {
+        delete node;
+    }
+}
 
-                for (size_t j = 0; j < base->nodes.size(); ++j) {
+std::shared_ptr<FunctionDefinition> FunctionDefinition::create(connector_id_t id)
+{
+    std::shared_ptr<FunctionDefinition> definition = std::make_shared<FunctionDefinition>(id);
+    function_definitions()[id] = definition;
+    return definition;
+}
 
-                    if (base->nodes[j] == input.target->host) {
-                        input.target = &(nodes[idxs[j]]->outputs[target_idx]);
-                    }
-                }
+std::shared_ptr<FunctionDefinition> FunctionDefinition::find(connector_id_t id)
+{
+    auto& definitions = function_definitions();
+    auto it = definitions.find(id);
+    return it != definitions.end() ? it->second.lock() : nullptr;
+}
 
-            }
-        }
+void FunctionDefinition::set_nodes(const std::vector<Node*>& new_nodes)
+{
+    nodes = new_nodes;
+    for (Node* node : nodes) {
+        node->move_to_container(&nodes);
     }
-    delete[] idxs;
+    attach_nodes();
+}
 
-    // populate and sort the arrays for where to route the input and output connectors on the function node
+void FunctionDefinition::attach_nodes()
+{
+    // populate and sort the arrays for where to route the input and output connectors on the function nodes
+    input_targs.clear();
+    output_targs.clear();
     for (Node* node : nodes) {
+
         if (node->isInput()) {
             input_targs.push_back(node);
         }
@@ -1235,7 +1637,6 @@ FunctionNode::FunctionNode(const FunctionNode* base): Node(base), is_single_tick
             output_targs.push_back(node);
         }
     }
-
     std::sort(input_targs.begin(), input_targs.end(), [](Node* a, Node* b) {
         return a->pos.y > b->pos.y; // Return true if 'a' should come before 'b'
         });
@@ -1244,14 +1645,124 @@ FunctionNode::FunctionNode(const FunctionNode* base): Node(base), is_single_tick
         return a->pos.y > b->pos.y; // Return true if 'a' should come before 'b'
         });
 
+    order = nodes;
+
+    state_size = 0;
+    functions.clear();
+    for (Node* node : nodes) {
+        FunctionNode* function = dynamic_cast<FunctionNode*>(node);
+        functions.push_back(function);
+        state_size += 1 + node->outputs.size();
+        if (function) {
+            state_size += function->state.size();
+            function->in_body = true;
+        }
+    }
+    table.clear();
+    memo.clear();
+    memo_index.clear();
+    // new instances start out in the state the body was loaded in
+    store_state(initial_state);
+    loaded = nullptr;
+
+    analysis_valid = false;
+    // single tick functions step the body once per tick, drivers have to come first
+    sort_linear();
+}
+
+size_t FunctionDefinition::input_pin_count() const
+{
+    size_t count = 0;
+    for (Node* node : input_targs) count += node->outputs.size();
+    return count;
+}
+
+size_t FunctionDefinition::output_pin_count() const
+{
+    size_t count = 0;
+    for (Node* node : output_targs) count += node->inputs.size();
+    return count;
+}
+
+void FunctionDefinition::store_state(std::vector<bool>& state) const
+{
+    state.resize(state_size);
+    size_t i = 0;
+    for (size_t n = 0; n < nodes.size(); n++) {
+        const Node* node = nodes[n];
+        state[i++] = node->has_changed;
+        for (const Output_connector& output : node->outputs) {
+            state[i++] = output.state;
+        }
+        if (const FunctionNode* function = functions[n]) {
+            std::copy(function->state.begin(), function->state.end(), state.begin() + i);
+            i += function->state.size();
+        }
+    }
+}
+
+void FunctionDefinition::restore_state(const std::vector<bool>& state)
+{
+    assert(state.size() == state_size);
+    size_t i = 0;
+    for (size_t n = 0; n < nodes.size(); n++) {
+        Node* node = nodes[n];
+        node->has_changed = state[i++];
+        for (Output_connector& output : node->outputs) {
+            output.state = state[i++];
+        }
+        if (FunctionNode* function = functions[n]) {
+            std::copy(state.begin() + i, state.begin() + i + function->state.size(), function->state.begin());
+            i += function->state.size();
+            // its body holds the state of whichever instance of the outer function stepped last
+            if (function->definition->loaded == function) function->definition->loaded = nullptr;
+        }
+    }
+}
+
+std::vector<const FunctionDefinition*> CollectFunctionDefinitions(const std::vector<Node*>& nodes)
+{
+    std::vector<const FunctionDefinition*> definitions;
+    std::unordered_set<const FunctionDefinition*> seen;
+
+    std::function<void(const std::vector<Node*>&)> visit = [&](const std::vector<Node*>& network) {
+        for (Node* node : network) {
+            FunctionNode* function = dynamic_cast<FunctionNode*>(node);
+            if (!function || !seen.insert(function->definition.get()).second) continue;
+            visit(function->definition->nodes);
+            definitions.push_back(function->definition.get());
+        }
+    };
+    visit(nodes);
+
+    return definitions;
+}
+
+json FunctionDefinitionsToJson(const std::vector<Node*>& nodes)
+{
+    json definitions = json::array();
+    for (const FunctionDefinition* definition : CollectFunctionDefinitions(nodes)) {
+        json body = json::array();
+        for (Node* node : definition->nodes)
+            body.push_back(node->to_JSON());
+
+        definitions.push_back({
+            {"id", definition->id},
+            {"label", definition->label},
+            {"nodes", body}
+        });
+    }
+    return definitions;
+}
+
+FunctionNode::FunctionNode(const FunctionNode* base): Node(base), definition(base->definition), state(base->state), is_single_tick(base->is_single_tick)
+{
     recompute_size();
 }
 
 FunctionNode::~FunctionNode()
 {
-    for (Node* node : nodes) {
-        delete node;
-    }
+    if (definition->loaded == this) definition->loaded = nullptr;
 }
 
 bool FunctionNode::show_node_editor()
@@ -1270,7 +1781,7 @@ bool FunctionNode::show_node_editor()
     static bool TextBoxNodeLabelEditMode = false;
     const static size_t buffersize = 256;
     char TextBoxNodeLabel[256] = "";
-    strcpy_s(TextBoxNodeLabel, buffersize, label.c_str());
+    snprintf(TextBoxNodeLabel, buffersize, "%s", label.c_str());
 
     GuiPanel(area, "Node Settings");
     
@@ -1302,7 +1813,7 @@ bool FunctionNode::show_node_editor()
         GuiLabel(Rectangle{ current_x, Pos.y + current_depth, 64, 32 }, "is_cyclic:");
         current_x += 64 + margin;
 
-        if (is_cyclic_val.value()) {
+        if (is_cyclic()) {
             GuiLabel(Rectangle{ current_x, Pos.y + current_depth, 64, 32 }, "true");
             current_x += 64 + margin;
         }
@@ -1371,19 +1882,10 @@ bool FunctionNode::show_node_editor()
         curr_el_h = 32;
         float current_x = Pos.x + margin;
 
-        if (is_cyclic()){}
-        else if (!is_single_tick) {
-            GuiToggle(Rectangle{ current_x, Pos.y + current_depth, 128, 32 }, "make_single_tick", &is_single_tick);
-            if (is_single_tick) 
-                delay_str = "1";
-            current_depth += curr_el_h;
-        }
-        else {
-            GuiToggle(Rectangle{ current_x, Pos.y + current_depth, 128, 32 }, "make_normal_timing", &is_single_tick);
-            if (!is_single_tick)
-                delay_str = std::to_string(delay());
-            current_depth += curr_el_h;
-        }
+        bool single_tick = is_single_tick;
+        GuiToggle(Rectangle{ current_x, Pos.y + current_depth, 128, 32 }, is_single_tick ? "make_normal_timing" : "make_single_tick", &single_tick);
+        if (single_tick != is_single_tick) set_single_tick(single_tick);
+        current_depth += curr_el_h;
     }
 
     {   // Spacing line
@@ -1410,6 +1912,7 @@ json FunctionNode::to_JSON() const
         jInputs.push_back(input.to_JSON());
     }
 
+    // the body is saved once in the definitions table of the save
     json myJson = {
         {get_type(),
             {
@@ -1420,74 +1923,104 @@ json FunctionNode::to_JSON() const
                 {"label", label},
                 {"outputs", jOutputs},
                 {"inputs", jInputs},
-                {"nodes", json::array()}
+                {"definition", definition->id},
+                {"state", state}
             }
         }
     };
 
-    for (Node* node : nodes)
-        myJson[get_type()]["nodes"].push_back(node->to_JSON());
-
     return myJson;
 }
 
 void FunctionNode::load_extra_JSON(const json& nodeJson)
 {
     try {
-        // load all the nodes
-        nodes.clear();
+        if (nodeJson.contains("definition")) {
+            connector_id_t id = nodeJson.at("definition").get<connector_id_t>();
+            std::shared_ptr<FunctionDefinition> found = FunctionDefinition::find(id);
+            if (!found) {
+                std::cerr << "JSON parsing error: function definition " << id << " is not in the save\n";
+                return;
+            }
+            set_definition(found);
+
+            if (nodeJson.contains("state")) {
+                std::vector<bool> loaded_state = nodeJson.at("state").get<std::vector<bool>>();
+                if (loaded_state.size() == state.size())
+                    state = std::move(loaded_state);
+            }
+            return;
+        }
+
+        // older saves embed the whole body in every instance
+        std::vector<Node*> body;
         if (nodeJson.contains(get_type()))
-            NodeNetworkFromJson(nodeJson.at(get_type()).at("nodes"), &nodes);
+            NodeNetworkFromJson(nodeJson.at(get_type()).at("nodes"), &body);
         else if (nodeJson.contains("nodes"))
-            NodeNetworkFromJson(nodeJson.at("nodes"), &nodes);
+            NodeNetworkFromJson(nodeJson.at("nodes"), &body);
         else
             std::cerr << "JSON parsing error: \n";
 
-        // populate and sort the arrays for where to route the input and output connectors on the function node
-        for (Node* node : nodes) {
+        set_nodes(body);
+    }
+    catch (const json::exception& e) {
+        // Handle or log error, e.g., missing key or wrong type
+        std::cerr << "JSON parsing error: " << e.what() << '\n';
+    }
+}
 
-            if (node->isInput()) {
-                input_targs.push_back(node);
-            }
-            if (node->isOutput()) {
-                output_targs.push_back(node);
-            }
-        }
-        std::sort(input_targs.begin(), input_targs.end(), [](Node* a, Node* b) {
-            return a->pos.y > b->pos.y; // Return true if 'a' should come before 'b'
-            });
+void FunctionNode::save_extra_binary(BinaryWriter& writer) const
+{
+    writer.varint(writer.definition_index(definition.get()));
+    writer.bits(state);
+}
 
-        std::sort(output_targs.begin(), output_targs.end(), [](Node* a, Node* b) {
-            return a->pos.y > b->pos.y; // Return true if 'a' should come before 'b'
-            });
+void FunctionNode::load_extra_binary(BinaryReader& reader)
+{
+    // version 1 embeds the whole body in every instance
+    if (reader.version < 2) {
+        std::vector<Node*> body;
+        NodeNetworkFromBinary(reader, &body);
+        set_nodes(body);
+        return;
+    }
 
-        // create input and output connectors then resize the node
-        size_t targ_input_count = 0;
-        for (size_t i = 0; i < input_targs.size(); i++) {
-            for (size_t j = 0; j < input_targs[i]->outputs.size(); j++) {
-                targ_input_count++;
-            }
-        }
-        size_t targ_output_count = 0;
-        for (size_t i = 0; i < output_targs.size(); i++) {
-            for (size_t j = 0; j < output_targs[i]->inputs.size(); j++) {
-                targ_output_count++;
-            }
-        }
+    uint64_t index = reader.varint();
+    if (index >= reader.definitions.size()) {
+        reader.failed = true;
+        return;
+    }
+    set_definition(reader.definitions[index]);
 
-        while (inputs.size() < targ_input_count) {
-            inputs.push_back(Input_connector(this, inputs.size()));
-        }
-        while (outputs.size() < targ_output_count) {
-            outputs.push_back(Output_connector(this, outputs.size()));
-        }
-        is_cyclic_val = is_cyclic();
-        recompute_size();
+    std::vector<bool> loaded_state = reader.bits();
+    if (loaded_state.size() == state.size())
+        state = std::move(loaded_state);
+}
+
+void FunctionNode::set_nodes(const std::vector<Node*>& new_nodes)
+{
+    std::shared_ptr<FunctionDefinition> new_definition = FunctionDefinition::create();
+    new_definition->label = label;
+    new_definition->set_nodes(new_nodes);
+    set_definition(new_definition);
+}
+
+void FunctionNode::set_definition(const std::shared_ptr<FunctionDefinition>& new_definition)
+{
+    if (definition->loaded == this) definition->loaded = nullptr;
+    definition = new_definition;
+    state = definition->initial_state;
+
+    // create input and output connectors then resize the node
+    size_t targ_input_count = definition->input_pin_count();
+    size_t targ_output_count = definition->output_pin_count();
+    while (inputs.size() < targ_input_count) {
+        inputs.push_back(Input_connector(this, inputs.size()));
     }
-    catch (const json::exception& e) {
-        // Handle or log error, e.g., missing key or wrong type
-        std::cerr << "JSON parsing error: " << e.what() << '\n';
+    while (outputs.size() < targ_output_count) {
+        outputs.push_back(Output_connector(this, outputs.size()));
     }
+    recompute_size();
 }
 
 void FunctionNode::draw()
@@ -1523,8 +2056,8 @@ void FunctionNode::draw()
     //draw inputs
     {
         size_t i = 0;
-        for (size_t x = 0; x < input_targs.size(); x++) {
-            for (size_t y = 0; y < input_targs[x]->outputs.size(); y++) {
+        for (size_t x = 0; x < definition->input_targs.size(); x++) {
+            for (size_t y = 0; y < definition->input_targs[x]->outputs.size(); y++) {
                 inputs[i].draw();
 
                 const size_t width = 30;
@@ -1537,9 +2070,9 @@ void FunctionNode::draw()
                 };
 
                 Font font = GetFontDefault();
-                const char* text = input_targs[x]->label.c_str();
+                const char* text = definition->input_targs[x]->label.c_str();
                 Color color = RAYWHITE;
-                if (input_targs[x]->outputs[y].state)
+                if (inputs[i].target && inputs[i].target->state)
                     color = DARKGREEN;
                 DrawTextEx(font, text, pos + Vector2{ width, 0 }, 12, text_spacing, color);
                 i++;
@@ -1552,8 +2085,8 @@ void FunctionNode::draw()
     //draw outputs
     {
         size_t i = 0;
-        for (size_t x = 0; x < output_targs.size(); x++) {
-            for (size_t y = 0; y < output_targs[x]->inputs.size(); y++) {
+        for (size_t x = 0; x < definition->output_targs.size(); x++) {
+            for (size_t y = 0; y < definition->output_targs[x]->inputs.size(); y++) {
                 outputs[i].draw();
 
                 const size_t width = 30;
@@ -1568,11 +2101,11 @@ void FunctionNode::draw()
 
                 Font font = GetFontDefault();
                 const char* text;
-                text = output_targs[x]->label.c_str();
+                text = definition->output_targs[x]->label.c_str();
                 Color color = RAYWHITE;
-                if (output_targs[x]->inputs[y].target && output_targs[x]->inputs[y].target->state)
+                if (outputs[i].state)
                     color = DARKGREEN;
-                DrawTextEx(font, text, pos - Vector2{ float(output_targs[x]->label.size()) * (text_spacing + 7.0f), 0 }, 12, text_spacing, color);
+                DrawTextEx(font, text, pos - Vector2{ float(definition->output_targs[x]->label.size()) * (text_spacing + 7.0f), 0 }, 12, text_spacing, color);
                 i++;
             }
         }
@@ -1583,240 +2116,260 @@ void FunctionNode::draw()
 void FunctionNode::pretick()
 {
     Game& game = Game::getInstance();
+    FunctionDefinition& body = *definition;
+
+    // the table reads the pins directly and never touches the body
+    if (game.function_tables && !in_body && !body.is_cyclic()) {
+        pretick_table();
+        return;
+    }
+
+    // the body holds the state of the instance that stepped it last
+    if (body.loaded != this) {
+        body.restore_state(state);
+        body.loaded = this;
+    }
+
     {
         size_t i = 0;
-        for (size_t x = 0; x < input_targs.size(); x++) {
-            for (size_t y = 0; y < input_targs[x]->outputs.size(); y++) {
+        for (size_t x = 0; x < body.input_targs.size(); x++) {
+            for (size_t y = 0; y < body.input_targs[x]->outputs.size(); y++) {
                 if (inputs[i].target) {
                     if (inputs[i].target->host->has_changed) {
                         has_changed = true;
-                        input_targs[x]->outputs[y].state = inputs[i].target->state;
-                        input_targs[x]->outputs[y].host->has_changed = true;
+                        body.input_targs[x]->outputs[y].state = inputs[i].target->state;
+                        body.input_targs[x]->outputs[y].host->has_changed = true;
                     }
                 }
                 else
-                    input_targs[x]->outputs[y].state = false;
+                    body.input_targs[x]->outputs[y].state = false;
                 i++;
             }
         }
     }
-    
-    if (is_single_tick) {
 
-        if (has_changed) {
-            for (Node* node : nodes) {
-                node->pretick();
+    // the whole body steps here, its outputs reach the pins in tick like those of any other node
+    Profiler* profiler = game.profiler.enabled ? &game.profiler : nullptr;
+    if (is_single_tick) {
+        // the order steps drivers first, so one pass settles a body without loops between its nodes.
+        // Otherwise the pass repeats until the body stops changing, at most loop_iteration_limit
+        // times. The pins tick last, nested functions only copy pins whose node has_changed.
+        stepped = has_changed;
+        if (stepped) {
+            int passes = body.settles_in_one_pass() ? 1 : Netlist::loop_iteration_limit;
+            for (int pass = 0; pass < passes; pass++) {
+                bool settled = true;
+                begin_bus_phase(&body.nodes);
+                for (Node* node : body.order) {
+                    if (profiler) profiler->pretick(node);
+                    else node->pretick();
+                    if (node->isInput()) continue;
+                    if (profiler) profiler->tick(node);
+                    else node->tick();
+                    if (node->has_changed) settled = false;
+                }
+                if (settled) break;
+            }
+            for (Node* node : body.input_targs) {
                 node->tick();
             }
         }
     }
     else {
-
-        if (has_changed ||!game.get_efficient_simulation()) {
-            for (Node* node : nodes) {
-                node->pretick();
+        stepped = has_changed || !game.get_efficient_simulation();
+        if (stepped) {
+            begin_bus_phase(&body.nodes);
+            for (Node* node : body.order) {
+                if (profiler) profiler->pretick(node);
+                else node->pretick();
+            }
+            for (Node* node : body.order) {
+                if (profiler) profiler->tick(node);
+                else node->tick();
             }
         }
     }
-}
+    if (!stepped) return;
 
-void FunctionNode::tick()
-{
-    Game& game = Game::getInstance();
-    if (is_single_tick) {
-        if (has_changed || !game.get_efficient_simulation()) {
-            has_changed = false;
-            for (Node* node : nodes) {
-                if (node->has_changed) has_changed = true;
-            }
-            {
-                size_t i = 0;
-                for (size_t x = 0; x < output_targs.size(); x++) {
-                    for (size_t y = 0; y < output_targs[x]->inputs.size(); y++) {
-                        if (output_targs[x]->inputs[y].target) {
-                            if (outputs[i].state != output_targs[x]->inputs[y].target->state) {
-                                outputs[i].state = output_targs[x]->inputs[y].target->state;
-                                has_changed = true;
-                            }
-                        }
-                        else outputs[i].new_state = false;
-                        i++;
-                    }
-                }
-            }
-        }
-        return;
+    body_changed = false;
+    for (Node* node : body.order) {
+        if (node->has_changed) body_changed = true;
     }
-    if (has_changed || !game.get_efficient_simulation()) {
-        has_changed = false;
-        for (Node* node : nodes) {
-            node->tick();
-            if (node->has_changed) has_changed = true;
-        }
 
-        {
-            size_t i = 0;
-            for (size_t x = 0; x < output_targs.size(); x++) {
-                for (size_t y = 0; y < output_targs[x]->inputs.size(); y++) {
-                    if (output_targs[x]->inputs[y].target) {
-                        if (outputs[i].state != output_targs[x]->inputs[y].target->state) {
-                            outputs[i].state = output_targs[x]->inputs[y].target->state;
-                            has_changed = true;
-                        }
-                    }
-                    else outputs[i].new_state = false;
-                    i++;
-                }
+    {
+        size_t i = 0;
+        for (size_t x = 0; x < body.output_targs.size(); x++) {
+            for (size_t y = 0; y < body.output_targs[x]->inputs.size(); y++) {
+                Output_connector* target = body.output_targs[x]->inputs[y].target;
+                outputs[i].new_state = target && target->state;
+                i++;
             }
         }
     }
+
+    body.store_state(state);
 }
 
-bool FunctionNode::is_cyclic() const
+void FunctionNode::pretick_table()
 {
-    if (is_cyclic_val.has_value()) {
-        return is_cyclic_val.value();
-    }
-
-    enum NodeState {
-        Unvisited,
-        Visiting,  // Node is being visited (used for cycle detection)
-        Visited    // Node has been fully visited
-    };
-
-    std::unordered_map<Output_connector*, NodeState> marked_outconns;
-    bool hasCycle = false;
-
-    std::function<void(Output_connector*)> DFS;
-
-
-    DFS = [&](Output_connector* outconn) {
-        if (hasCycle || !outconn) return;
+    Game& game = Game::getInstance();
 
-        if (marked_outconns[outconn] == NodeState::Visiting) {
-            hasCycle = true;
-            return;
-        }
+    table_pins.resize(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        table_pins[i] = inputs[i].target && inputs[i].target->state;
+    }
 
-        if (outconn->host->is_cyclic()) {
-            hasCycle = true;
-            return;
-        }
+    // the outputs follow the pins after the delay of the body, a single tick function settles every tick
+    size_t latency = is_single_tick ? 1 : size_t(definition->table_latency());
+    if (table_history.size() != latency) {
+        std::vector<bool> current(outputs.size());
+        for (size_t i = 0; i < outputs.size(); i++) current[i] = outputs[i].state;
+        table_history.assign(latency, current);
+        table_head = 0;
+    }
 
-        if (marked_outconns[outconn] == NodeState::Visited) {
-            return;
-        }
+    table_history[table_head] = definition->settled_outputs(table_pins, game.function_table_max_inputs, game.function_memo_entries);
+    table_head = (table_head + 1) % latency;
 
-        marked_outconns[outconn] = NodeState::Visiting;
-        
-        for (Input_connector* inconn : outconn->host->connected_inputs(outconn->index)) {
-            DFS(inconn->target);
-            if (hasCycle) return;
-        }
+    // the entry written latency - 1 ticks ago
+    const std::vector<bool>& result = table_history[table_head];
+    for (size_t i = 0; i < outputs.size(); i++) {
+        outputs[i].new_state = result[i];
+    }
+    stepped = true;
+    body_changed = false;
+}
 
-        marked_outconns[outconn] = NodeState::Visited;
-    };
+void FunctionNode::tick()
+{
+    if (!stepped) return;
 
-    for (Node* outnode : output_targs) {
-        for (Input_connector& inconn : outnode->inputs) {
-            DFS(inconn.target);
-            if (hasCycle) return true;
-            marked_outconns.clear();
+    has_changed = body_changed;
+    for (Output_connector& output : outputs) {
+        if (output.state != output.new_state) {
+            output.state = output.new_state;
+            has_changed = true;
         }
     }
-
-    return false;
 }
 
-int FunctionNode::delay() const
+int FunctionDefinition::table_latency()
 {
-    if (is_cyclic()) return -1;
-
-    std::unordered_map<Output_connector*, int> marked_outconns;
-    int max_delay = 1;
-    std::function<void(Output_connector*)> DFS;
+    return std::max(1, delay());
+}
 
+void FunctionDefinition::settle(const std::vector<bool>& pins, std::vector<bool>& outputs)
+{
+    Game& game = Game::getInstance();
 
-    DFS = [&](Output_connector* outconn) {
-        if (!outconn || max_delay == -1) return;
+    std::vector<bool> saved;
+    store_state(saved);
+    const FunctionNode* saved_loaded = loaded;
+    bool saved_efficient = game.efficient_simulation;
+    game.efficient_simulation = false;
 
-        if (outconn->host->is_cyclic()) {
-            max_delay = -1;
-            return;
+    size_t i = 0;
+    for (Node* targ : input_targs) {
+        for (Output_connector& output : targ->outputs) {
+            output.state = pins[i++];
         }
+    }
+    for (Node* node : nodes) {
+        node->has_changed = true;
+    }
 
-        if (outconn->host->isInput()) return;
-
-        int current_delay = marked_outconns[outconn] + outconn->host->delay();
-        if (current_delay > max_delay) max_delay = current_delay;
-
-        for (Input_connector* inconn : outconn->host->connected_inputs(outconn->index)) {
-            if (marked_outconns[inconn->target] < current_delay) {
-                marked_outconns[inconn->target] = current_delay;
-                DFS(inconn->target);
-                if (max_delay == -1) return;
-            }
+    // no path through an acyclic body takes longer than its delay
+    for (int step = 0; step < table_latency(); step++) {
+        begin_bus_phase(&nodes);
+        for (Node* node : order) {
+            node->pretick();
         }
-    };
+        for (Node* node : order) {
+            node->tick();
+        }
+    }
 
-    for (Node* outnode : output_targs) {
-        for (Input_connector& inconn : outnode->inputs) {
-            DFS(inconn.target);
+    outputs.clear();
+    for (Node* targ : output_targs) {
+        for (Input_connector& input : targ->inputs) {
+            outputs.push_back(input.target && input.target->state);
         }
     }
 
-    return max_delay;
+    game.efficient_simulation = saved_efficient;
+    restore_state(saved);
+    loaded = saved_loaded;
 }
 
-
-void FunctionNode::sort_linear()
+const std::vector<bool>& FunctionDefinition::settled_outputs(const std::vector<bool>& pins, size_t max_table_inputs, size_t memo_entries)
 {
-    if (is_cyclic()) return ;
-
-    std::unordered_map<Output_connector*, int> marked_outconns;
-    int max_delay = 1;
-    std::function<void(Output_connector*)> DFS;
+    if (pins.size() <= max_table_inputs && pins.size() < 8 * sizeof(size_t)) {
+        if (table.empty()) {
+            table.resize(size_t(1) << pins.size());
+            std::vector<bool> row(pins.size());
+            for (size_t index = 0; index < table.size(); index++) {
+                for (size_t i = 0; i < row.size(); i++) row[i] = (index >> i) & 1;
+                settle(row, table[index]);
+            }
+        }
+        size_t index = 0;
+        for (size_t i = 0; i < pins.size(); i++) {
+            if (pins[i]) index |= size_t(1) << i;
+        }
+        return table[index];
+    }
 
+    auto it = memo_index.find(pins);
+    if (it != memo_index.end()) {
+        memo.splice(memo.begin(), memo, it->second);
+        return it->second->second;
+    }
 
-    DFS = [&](Output_connector* outconn) {
-        if (!outconn || max_delay == -1) return;
+    std::vector<bool> outputs;
+    settle(pins, outputs);
+    memo.emplace_front(pins, std::move(outputs));
+    memo_index[pins] = memo.begin();
+    while (memo.size() > std::max<size_t>(1, memo_entries)) {
+        memo_index.erase(memo.back().first);
+        memo.pop_back();
+    }
+    return memo.front().second;
+}
 
-        if (outconn->host->is_cyclic()) {
-            max_delay = -1;
-            return;
-        }
+const GraphAnalysis& FunctionDefinition::analysis() const
+{
+    if (!analysis_valid) {
+        analysis_val.analyze(nodes, output_targs);
+        analysis_valid = true;
+    }
+    return analysis_val;
+}
 
-        if (outconn->host->isInput()) return;
+bool FunctionDefinition::is_cyclic() const
+{
+    return analysis().cyclic;
+}
 
-        int current_delay = marked_outconns[outconn] + outconn->host->delay();
-        if (current_delay > max_delay) max_delay = current_delay;
+bool FunctionDefinition::settles_in_one_pass() const
+{
+    return !analysis().cyclic && !analysis().node_loops;
+}
 
-        for (Input_connector* inconn : outconn->host->connected_inputs(outconn->index)) {
-            if (marked_outconns[inconn->target] < current_delay) {
-                marked_outconns[inconn->target] = current_delay;
-                DFS(inconn->target);
-                if (max_delay == -1) return;
-            }
-        }
-    };
+int FunctionDefinition::delay() const
+{
+    return analysis().delay;
+}
 
-    for (Node* outnode : output_targs) {
-        for (Input_connector& inconn : outnode->inputs) {
-            DFS(inconn.target);
-        }
-    }
+void FunctionDefinition::sort_linear()
+{
+    order = analysis().linear_order;
+}
 
-    std::sort(nodes.begin(), nodes.end(), [&](Node* a, Node* b) {
-        size_t max_a = 0;
-        for (Output_connector& out : a->outputs) {
-            if (marked_outconns[&out] > max_a) max_a = marked_outconns[&out];
-        }
-        size_t max_b = 0;
-        for (Output_connector& out : b->outputs) {
-            if (marked_outconns[&out] > max_b) max_b = marked_outconns[&out];
-        }
-        return max_a > max_b; // Return true if 'a' should come before 'b'
-        });
+void FunctionNode::set_single_tick(bool single_tick)
+{
+    is_single_tick = single_tick;
+    delay_str = single_tick ? "1" : std::to_string(delay());
+    Game::getInstance().invalidate_netlist();
 }
 
 void FunctionNode::recompute_size()
@@ -1947,28 +2500,105 @@ void PushButton::clicked(Vector2 pos)
     }
 }
 
-void Bus::pretick()
+// the bus groups of every container by label, a container's entry goes away with its last bus
+static std::unordered_map<const std::vector<Node*>*, std::unordered_map<std::string, std::unique_ptr<BusGroup>>>& bus_registry()
+{
+    static std::unordered_map<const std::vector<Node*>*, std::unordered_map<std::string, std::unique_ptr<BusGroup>>> registry;
+    return registry;
+}
+
+void Bus::join(const BusGroup* values)
+{
+    std::unique_ptr<BusGroup>& slot = bus_registry()[container][label];
+    if (!slot) {
+        slot = std::make_unique<BusGroup>();
+        if (values) {
+            slot->words = values->words;
+            slot->width = values->width;
+        }
+    }
+    group = slot.get();
+    member_index = group->members.size();
+    group->members.push_back(this);
+    fit_values();
+}
+
+void Bus::leave()
 {
-    if (!*bus_values_has_updated) {
-        for (size_t i = 0; i < (*bus_values).size(); i++) {
-            (*bus_values)[i] = false;
+    if (!group) return;
+    group->members[member_index] = group->members.back();
+    group->members[member_index]->member_index = member_index;
+    group->members.pop_back();
+
+    if (group->members.empty()) {
+        auto groups = bus_registry().find(container);
+        groups->second.erase(label);
+        if (groups->second.empty()) bus_registry().erase(groups);
+    }
+    group = nullptr;
+}
+
+void Bus::fit_values()
+{
+    group->fit(inputs.size());
+}
+
+void Bus::move_to_container(std::vector<Node*> * new_container)
+{
+    if (new_container == container) return;
+    // the values come along unless the label already has a line in the new container
+    BusGroup values;
+    values.words = group->words;
+    values.width = group->width;
+    leave();
+    Node::move_to_container(new_container);
+    join(&values);
+}
+
+void BusGroup::resolve()
+{
+    std::fill(words.begin(), words.end(), 0);
+    for (Bus* bus : members) {
+        const size_t bits = bus->inputs.size();
+        for (size_t first = 0; first < bits; first += 64) {
+            const size_t last = std::min(bits, first + 64);
+            uint64_t word = 0;
+            for (size_t i = first; i < last; i++) {
+                const Output_connector* target = bus->inputs[i].target;
+                word |= uint64_t(target && target->state) << (i - first);
+            }
+            words[first >> 6] |= word;
         }
     }
-    for (size_t i = 0; i < inputs.size(); i++) {
-        if (inputs[i].target && inputs[i].target->state)
-            (*bus_values)[i] = true;
+    resolved = true;
+}
+
+void begin_bus_phase(const std::vector<Node*> * container)
+{
+    auto groups = bus_registry().find(container);
+    if (groups == bus_registry().end()) return;
+    for (auto& [label, group] : groups->second) {
+        group->resolved = false;
     }
-    *bus_values_has_updated = true;
+}
+
+void Bus::pretick()
+{
+    if (!group->resolved) group->resolve();
 }
 
 void Bus::tick()
 {
     has_changed = false;
-    *bus_values_has_updated = false;
-    for (size_t i = 0; i < outputs.size(); i++) {
-        if ((*bus_values)[i] != outputs[i].state) {
-            has_changed = true;
-            outputs[i].state = (*bus_values)[i];
+    for (size_t first = 0; first < outputs.size(); first += 64) {
+        const size_t last = std::min(outputs.size(), first + 64);
+        const uint64_t word = group->words[first >> 6];
+        for (size_t i = first; i < last; i++) {
+            bool value = (word >> (i - first)) & 1;
+            if (value != outputs[i].state) {
+                has_changed = true;
+                outputs[i].state = value;
+            }
         }
     }
 }
@@ -2001,28 +2631,39 @@ json Bus::to_JSON() const {
             }
         }
     };
-    for (bool val : (*bus_values)) {
-        myJson[get_type()]["bus_values"].push_back(val);
+    for (size_t i = 0; i < group->width; i++) {
+        myJson[get_type()]["bus_values"].push_back(group->get(i));
     }
 
     return myJson;
 }
 
+void Bus::save_extra_binary(BinaryWriter& writer) const {
+    std::vector<bool> values(group->width);
+    for (size_t i = 0; i < group->width; i++) values[i] = group->get(i);
+    writer.bits(values);
+}
+
+void Bus::load_extra_binary(BinaryReader& reader) {
+    fit_values();
+
+    std::vector<bool> loaded_bus_vals = reader.bits();
+    for (size_t i = 0; i < loaded_bus_vals.size() && i < group->width; i++) {
+        group->set(i, loaded_bus_vals[i]);
+    }
+}
+
 void Bus::load_extra_JSON(const json& nodeJson) {
-    find_connections();
+    fit_values();
 
     // Assuming 'type' is the key for your main object.
     // Replace 'type' with whatever your main object's key is.
     if (nodeJson.contains(get_type()) && nodeJson[get_type()].contains("bus_values")) {
         std::vector<bool> loaded_bus_vals = nodeJson[get_type()]["bus_values"].get<std::vector<bool>>();
 
-        if (loaded_bus_vals.size() >= bus_values->size()) {
-            *bus_values = loaded_bus_vals;
-        }
-        else {
-            for (size_t i = 0; i < loaded_bus_vals.size(); i++) {
-                (*bus_values)[i] = loaded_bus_vals[i];
-            }
+        group->fit(loaded_bus_vals.size());
+        for (size_t i = 0; i < loaded_bus_vals.size(); i++) {
+            group->set(i, loaded_bus_vals[i]);
         }
 
     }
@@ -2,16 +2,29 @@
 #include "gui_ui.h"
 #include <vector>
 #include "random_id.h"
+#include "netlist.h"
+#include "sim_thread.h"
+#include "graph_analysis.h"
+#include "profiler.h"
+#include "activity_stats.h"
+#include "vcd_recorder.h"
 
 #include "nlohmann/json.hpp"
 #include <utility>
+#include <algorithm>
+#include <list>
 
 using json = nlohmann::json;
 
 struct Output_connector;
 struct Input_connector;
 struct Node;
+struct Bus;
 class Game;
+class BinaryWriter;
+class BinaryReader;
+struct FunctionDefinition;
+class FunctionNode;
 
 struct GuiNodeEditorState;
 
@@ -22,6 +35,14 @@ enum EditMode {
     INTERACT,
 };
 
+enum SimulationMode {
+    GRAPH,      // steps the node objects through their virtual pretick/tick
+    COMPILED,   // steps a flat netlist lowered from the nodes
+    EVENT,      // steps the netlist but only evaluates gates whose inputs changed
+    PARALLEL,   // steps the netlist with the gates split over a thread pool
+    LEVELIZED,  // steps the netlist with zero delay gates, registers only where loops close
+};
+
 class Game {
 private:
     // Private constructor to prevent instantiation
@@ -50,11 +71,36 @@ public:
     bool warp = false;
     float targ_sim_hz = 16;
     float real_sim_hz = 0;
-    
+
+    SimulationMode sim_mode = GRAPH;
+    // has to be called after every structural edit, the netlist is recompiled before the next tick
+    void invalidate_netlist() {
+        netlist_valid = false; activity_valid = false;
+        if (waveform.recording()) stop_waveform();
+    }
+
+    // whether the compiled modes inline the bodies of FunctionNodes, see Netlist
+    bool flatten_functions = true;
+
+    // threads used by PARALLEL, including the main thread
+    int sim_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    // netlists with fewer signals are stepped on the main thread, waking the pool costs more than
+    // the gates. Counted after flattening, a few functions can hold thousands of gates.
+    size_t parallel_min_signals = 5000;
+
+    // step the compiled modes on a simulation thread instead of between frames
+    bool sim_on_thread = true;
+    // Starts, restarts or stops the simulation thread to match the mode and the circuit. Returns
+    // false when the caller has to step the simulation itself, ticks is set to the ticks the thread
+    // ran since the last call.
+    bool update_sim_thread(uint64_t& ticks);
 
     std::vector<Node*> nodes;
     std::vector<Node*> clipboard;
 
+    // definitions of the functions added from files by path, adding a file again adds another instance of the same definition
+    std::unordered_map<std::string, std::weak_ptr<FunctionDefinition>> function_library;
+
     std::vector< Input_connector* >selected_inputs;
     std::vector< Output_connector* >selected_outputs;
 
@@ -64,8 +110,12 @@ public:
 
     void tick();
 
+    // writes the compiled simulation state into the node connectors, draw does this every frame
+    void sync_netlist_to_editor();
+
     void unselect_all();
 
+    void add_node(Node* node);
     void remove_node(Node* node);
     void delete_selected_nodes();
     void copy_selected_nodes();
@@ -73,22 +123,86 @@ public:
 
     void handle_input();
 
+    // paths ending in .lgsb are saved in the binary format, load detects the format from the file
     void save(std::string filePath = "gamesave.json");
-    void load(std::string filePath = "gamesave.json");
+    void save_binary(std::string filePath);
+    bool load(std::string filePath = "gamesave.json");
 
     bool hovering_above_gui = false;
 
     bool get_efficient_simulation() const { return efficient_simulation; }
     bool efficient_simulation = false;
 
+    // Acyclic functions of the circuit look their outputs up instead of stepping their body, see
+    // FunctionNode::pretick. Up to function_table_max_inputs pins the whole truth table is built on
+    // first use, wider functions remember the last function_memo_entries input vectors they saw.
+    bool function_tables = false;
+    size_t function_table_max_inputs = 12;
+    size_t function_memo_entries = 4096;
+
+    // times the node steps of the graph simulation while enabled, draw heat maps the nodes by it
+    Profiler profiler;
+
+    // Toggle statistics of the simulated signals, sampled after every tick while enabled. The
+    // compiled modes sample the netlist signals, GRAPH the top level output connectors. It starts
+    // over after every structural edit, and the compiled modes stay off the simulation thread
+    // while it is enabled.
+    ActivityStats activity;
+    void restart_activity() { activity_valid = false; }
+
+    // Streams the outputs of the selected nodes, or of all nodes when none is selected, to a VCD
+    // file after every tick. The nodes inside a function are recorded in a module per instance,
+    // except in functions the compiled modes keep opaque. The compiled modes record on the
+    // simulation thread. Structural edits and mode changes end the recording, its wires are
+    // numbered for the circuit as it was.
+    bool start_waveform(const std::string& path);
+    void stop_waveform();
+    bool recording_waveform() const { return waveform.recording(); }
+
 private:
     bool area_selected = false;
     Vector2 first_corner = { 0,0 };
 
+    Netlist netlist;
+    bool netlist_valid = false;
+    // The engine of the step in progress. pretick decides it and tick finishes the step on it, so a
+    // mode switch or an edit in between can't split a step across the netlist and the editor graph.
+    SimulationMode step_mode = GRAPH;
+    // a compiled step is dropped when an edit invalidates the netlist before its tick, reported once
+    bool step_dropped_logged = false;
+    // whether activity was reset for the current circuit and mode
+    bool activity_valid = false;
+    SimulationMode activity_mode = GRAPH;
+    std::vector<uint64_t> activity_words;
+    void sample_activity();
+    VcdRecorder waveform;
+    // whether the waveform records netlist signals, GRAPH records the sources below packed in order
+    bool waveform_compiled = false;
+    struct WaveformSource {
+        // an output connector, or otherwise a bit of the function's state
+        const Output_connector* output;
+        const FunctionNode* function;
+        uint32_t bit;
+    };
+    std::vector<WaveformSource> waveform_sources;
+    std::vector<uint64_t> waveform_words;
+    const uint64_t* waveform_state();
+    std::unique_ptr<WorkStealingPool> sim_pool;
+    // pool for the PARALLEL mode, null when the circuit is stepped on one thread
+    WorkStealingPool* parallel_pool();
+    // declared last, the thread has to stop before the netlist and pool go away
+    SimulationThread sim_thread;
+
 };
 
 void NodeNetworkFromJson(const json& nodeNetworkJson, std::vector<Node*> * nodes);
 
+// Warns about connector ids that were used by several outputs or by no output while loading a network
+void ReportConnectorIdProblems(size_t duplicate_ids, size_t dangling_ids);
+
+// Loads the nodes of a JSON or binary save, and its camera if one is given. Returns false if the file can't be read.
+bool NodeNetworkFromFile(const std::string& filePath, std::vector<Node*> * nodes, Camera2D* camera = nullptr);
+
 void NormalizeNodeNetworkPosTocLocation(std::vector<Node*>& nodes, Vector2 targpos);
 
 struct Node {
@@ -97,7 +211,7 @@ public:
     
     Node(const Node* base);
 
-    virtual ~Node() {}
+    virtual ~Node();
 
     virtual size_t get_max_outputs() const { return 32; }
     virtual void reserve_outputs() { outputs.reserve(get_max_outputs()); }
@@ -151,6 +265,10 @@ public:
 
     virtual void load_extra_JSON(const json& nodeJson) {}
 
+    // type specific data of the binary format, see binary_save.h
+    virtual void save_extra_binary(BinaryWriter& writer) const {}
+    virtual void load_extra_binary(BinaryReader& reader) {}
+
     virtual bool isInput() const { return false; }
     virtual bool isOutput() const { return false; }
 
@@ -165,7 +283,7 @@ public:
         return input_nodes;
     }
 
-    void move_to_container(std::vector<Node*> * new_container) {
+    virtual void move_to_container(std::vector<Node*> * new_container) {
         container = new_container;
     }
 
@@ -177,13 +295,23 @@ protected:
 
 };
 
+// Identifies an input by its host and index, unlike a pointer this survives the host's inputs being reallocated
+struct InputRef {
+    Node* host;
+    size_t index;
+};
+
 struct Input_connector {
-    Input_connector(Node* host, size_t index, Output_connector* target = nullptr, uid_t target_id = 0) : host(host), target(target), index(index), target_id(target_id) {}
+    Input_connector(Node* host, size_t index, Output_connector* target = nullptr, connector_id_t target_id = 0) : host(host), target(target), index(index), target_id(target_id) {}
     Node* host;
     Output_connector* target;
-    uid_t target_id;
+    connector_id_t target_id;
     size_t index;
 
+    // Reads from new_target (nullptr disconnects) and keeps the readers of the old and new target up to date
+    void connect(Output_connector* new_target);
+    void disconnect() { connect(nullptr); }
+
     Vector2 get_connection_pos() const{
         const float width = 30;
         float spacing = 30;
@@ -199,13 +327,19 @@ struct Input_connector {
 };
 
 struct Output_connector {
-    Output_connector(Node* host, size_t index, bool state = false, uid_t id = generate_id()) : host(host), index(index), state(state), new_state(false), id(id) { }
+    Output_connector(Node* host, size_t index, bool state = false, connector_id_t id = generate_id()) : host(host), index(index), state(state), new_state(false), id(id) { }
     Node* host;
     size_t index;
     bool state;
     bool new_state;
 
-    uid_t id;
+    connector_id_t id;
+
+    // inputs connected to this output, maintained by Input_connector::connect
+    std::vector<InputRef> readers;
+
+    // Disconnects every input reading from this output
+    void disconnect_readers();
 
     Vector2 get_connection_pos() const {
         const float width = 30.0f;
@@ -223,7 +357,10 @@ struct Output_connector {
 
 struct BinaryLogicGate : public Node {
     BinaryLogicGate(std::vector<Node*> * container, Vector2 pos = { 0,0 }, size_t input_count = 2, std::vector<Input_connector> input_connectors = {}) : Node(container, pos, { 0, 0 }, ColorBrightness(BLUE, -0.4f)) {
-        inputs.insert(inputs.end(), input_connectors.begin(), input_connectors.end());
+        for (const Input_connector& conn : input_connectors) {
+            inputs.push_back(Input_connector(this, inputs.size()));
+            inputs.back().connect(conn.target);
+        }
 
         while (inputs.size() < input_count)
             inputs.push_back(Input_connector(this, inputs.size()));
@@ -237,7 +374,11 @@ struct BinaryLogicGate : public Node {
     }
 
     virtual void remove_input() override {
-        if (inputs.size() > 1) inputs.pop_back();  recompute_size();
+        if (inputs.size() > 1) {
+            inputs.back().disconnect();
+            inputs.pop_back();
+        }
+        recompute_size();
     }
 };
 
@@ -278,7 +419,10 @@ struct GateOR : public BinaryLogicGate {
 struct GateNAND : public Node {
     GateNAND(std::vector<Node*> * container, Vector2 pos = { 0,0 }, size_t input_count = 2, std::vector<Input_connector> input_connectors = {}) : Node(container, pos, { 0, 0 }, ColorBrightness(BLUE, -0.4f)) {
         label = "NAND";
-        inputs.insert(inputs.end(), input_connectors.begin(), input_connectors.end());
+        for (const Input_connector& conn : input_connectors) {
+            inputs.push_back(Input_connector(this, inputs.size()));
+            inputs.back().connect(conn.target);
+        }
 
         while (inputs.size() < input_count)
             inputs.push_back(Input_connector(this, inputs.size()));
@@ -291,7 +435,11 @@ struct GateNAND : public Node {
         inputs.push_back(Input_connector(this, inputs.size())); recompute_size();
     }
     virtual void remove_input() override {
-        if (inputs.size() > 1) inputs.pop_back();  recompute_size();
+        if (inputs.size() > 1) {
+            inputs.back().disconnect();
+            inputs.pop_back();
+        }
+        recompute_size();
     }
 
     Node* copy() const override { return new GateNAND(this); }
@@ -360,7 +508,8 @@ struct GateXNOR : public BinaryLogicGate {
 
 struct UnaryLogicGate : public Node {
     UnaryLogicGate(std::vector<Node*> * container, Vector2 pos = { 0,0 }, Output_connector* input = nullptr) : Node(container, pos, { 0, 0 }, ColorBrightness(BLUE, -0.4f)) {
-        inputs.push_back(Input_connector(this, 0, input));
+        inputs.push_back(Input_connector(this, 0));
+        inputs.back().connect(input);
         recompute_size();
     }
     UnaryLogicGate(const UnaryLogicGate* base) : Node(base) {}
@@ -373,14 +522,10 @@ struct UnaryLogicGate : public Node {
         recompute_size();
     }
     virtual void remove_input() override {
-        Game& game = Game::getInstance();
         if (inputs.size() > 1) {
+            inputs.back().disconnect();
             inputs.pop_back();
-            for (Node* node : game.nodes) {
-                for (Input_connector& input : node->inputs) {
-                    if (input.target == &outputs.back()) input.target = nullptr;
-                }
-            }
+            outputs.back().disconnect_readers();
             outputs.pop_back();
         }
         recompute_size();
@@ -430,40 +575,58 @@ struct GateNOT : public UnaryLogicGate {
     virtual std::string get_type() const override { return"GateNOT"; }
 };
 
+// The buses of one container that share a label, together they are a single wired-OR line. Each
+// container keeps a registry of its groups by label, so joining and leaving one doesn't scan the
+// container.
+struct BusGroup {
+    // bit i of the line is bit i % 64 of words[i / 64]
+    std::vector<uint64_t> words;
+    // the bits in use, the widest member seen or the saved values
+    size_t width = 0;
+    // whether the line was resolved since the last bus phase began
+    bool resolved = false;
+    std::vector<Bus*> members;
+
+    bool get(size_t bit) const { return (words[bit >> 6] >> (bit & 63)) & 1; }
+    void set(size_t bit, bool value) {
+        if (value) words[bit >> 6] |= uint64_t(1) << (bit & 63);
+        else words[bit >> 6] &= ~(uint64_t(1) << (bit & 63));
+    }
+    void fit(size_t bits) {
+        width = std::max(width, bits);
+        words.resize((width + 63) / 64, 0);
+    }
+    // clears the line and ORs in what every member reads, word by word
+    void resolve();
+};
+
+// Starts a tick of the buses in the container. The first member to pretick afterwards resolves its
+// whole line, every member then reads it. Whoever steps a container calls this before the pretick
+// pass.
+void begin_bus_phase(const std::vector<Node*> * container);
+
 struct Bus : public Node {
     Bus(std::vector<Node*> * container, Vector2 pos = { 0,0 }, Output_connector* input = nullptr) : Node(container, pos, { 0, 0 }, ColorBrightness(BLUE, -0.4f)) {
+        // the base constructor reserved the default before this override existed
+        reserve_outputs();
         label = "BUS_0";
-        inputs.push_back(Input_connector(this, 0, input));
+        inputs.push_back(Input_connector(this, 0));
+        inputs.back().connect(input);
         recompute_size();
-        find_connections();
-        
+        join();
     }
+    // A copy isn't placed anywhere yet. It keeps the values of its base on a line of no container,
+    // which nothing steps, until move_to_container places it.
     Bus(const Bus* base) : Node(base) {
-        find_connections();
-    }
-
-    void find_connections() {
-        for (Node* node : *container) {
-            if (node) {
-                Bus* bus = dynamic_cast<Bus*>(node);
-                if (bus && bus != this) {
-                    if (bus->label == label) {
-                        bus_values_has_updated = bus->bus_values_has_updated;
-                        bus_values = bus->bus_values;
-                        while ((*bus_values).size() < inputs.size()) {
-                            (*bus_values).push_back(false);
-                        }
-                        return;
-                    }
-                }
-            }
-        }
+        reserve_outputs();
+        container = nullptr;
+        join(base->group);
+    }
 
-        bus_values_has_updated = std::make_shared<bool>();
-        bus_values = std::make_shared<std::vector<bool>>();
-        while ((*bus_values).size() < inputs.size()) {
-            (*bus_values).push_back(false);
-        }
+    // wide enough for several 64 bit data words
+    virtual size_t get_max_outputs() const override { return 256; }
+    ~Bus() override {
+        leave();
     }
 
     virtual void add_input() override {
@@ -471,37 +634,36 @@ struct Bus : public Node {
         inputs.push_back(Input_connector(this, inputs.size()));
         outputs.push_back(Output_connector(this, outputs.size(), false));
         recompute_size();
-        find_connections();
-
-
+        fit_values();
     }
 
     virtual void remove_input() override {
-        Game& game = Game::getInstance();
         if (inputs.size() > 1) {
+            inputs.back().disconnect();
             inputs.pop_back();
-            for (Node* node : game.nodes) {
-                for (Input_connector& input : node->inputs) {
-                    if (input.target == &outputs.back()) input.target = nullptr;
-                }
-            }
+            outputs.back().disconnect_readers();
             outputs.pop_back();
         }
         recompute_size();
-        find_connections();
     }
 
     virtual void change_label(const char* newlabel) override {
+        leave();
         label = newlabel;
-        find_connections();
+        join();
     }
 
+    virtual void move_to_container(std::vector<Node*> * new_container) override;
+
     Node* copy() const override { return new Bus(this); }
 
     virtual json to_JSON() const override;
 
     virtual void load_extra_JSON(const json& nodeJson) override;
 
+    virtual void save_extra_binary(BinaryWriter& writer) const override;
+    virtual void load_extra_binary(BinaryReader& reader) override;
+
     virtual std::string get_label() const override { return std::string(label); }
 
     virtual Texture get_texture() const override { return{ 0 }; }
@@ -513,20 +675,21 @@ struct Bus : public Node {
 
     virtual std::vector<Input_connector*> connected_inputs(size_t output_idx) {
         std::vector<Input_connector*> conned;
-
-        for (Node* node : *container) {
-            Bus* bus = dynamic_cast<Bus*>(node);
-            if (bus) {
-                if (bus->label == label && bus->inputs.size() > output_idx) {
-                    conned.push_back(&bus->inputs[output_idx]);
-                }
+        for (Bus* bus : group->members) {
+            if (bus->inputs.size() > output_idx) {
+                conned.push_back(&bus->inputs[output_idx]);
             }
         }
         return conned;
     }
 private:
-    std::shared_ptr<std::vector<bool>> bus_values;
-    std::shared_ptr<bool> bus_values_has_updated;
+    // joins the group of the label in the container, a new group starts from values if given
+    void join(const BusGroup* values = nullptr);
+    void leave();
+    void fit_values();
+
+    BusGroup* group = nullptr;
+    size_t member_index = 0;
 };
 
 struct Button :public Node {
@@ -545,12 +708,7 @@ struct Button :public Node {
 
     virtual void remove_input() override {
         if (outputs.size() > 1) {
-            Game& game = Game::getInstance();
-            for (Node* node : game.nodes) {
-                for (auto& conn : node->inputs) {
-                    if (conn.target == &outputs.back()) conn.target = nullptr;
-                }
-            }
+            outputs.back().disconnect_readers();
             outputs.pop_back();  recompute_size();
         }
     }
@@ -677,10 +835,84 @@ protected:
     virtual void recompute_size() override;
 };
 
+// The body of a function. Every FunctionNode loaded from the same save entry or copied from the
+// same instance points at one definition, the instances only own the state of the body.
+struct FunctionDefinition {
+    FunctionDefinition(connector_id_t id = generate_id()) : id(id) {}
+    ~FunctionDefinition();
+
+    // makes a definition that loads of the same id are resolved to while it is alive
+    static std::shared_ptr<FunctionDefinition> create(connector_id_t id = generate_id());
+    static std::shared_ptr<FunctionDefinition> find(connector_id_t id);
+
+    // identifies the definition in saves
+    connector_id_t id;
+    std::string label;
+
+    std::vector<Node*> nodes;
+    // the order the nodes are stepped in, levelized by sort_linear with the nodes of a loop sharing
+    // its level. nodes itself keeps the order of the state layout.
+    std::vector<Node*> order;
+
+    std::vector<Node*> input_targs;
+    std::vector<Node*> output_targs;
+
+    // takes ownership of loaded nodes as the body
+    void set_nodes(const std::vector<Node*>& new_nodes);
+    // routes the pins to the input and output nodes of the body and sizes the state, for loaders that fill nodes directly
+    void attach_nodes();
+
+    size_t input_pin_count() const;
+    size_t output_pin_count() const;
+
+    // Per node of the body its has_changed flag and output states, and the state of nested
+    // functions. An instance swaps its copy in before stepping the body and out after.
+    size_t state_size = 0;
+    std::vector<bool> initial_state;
+    void store_state(std::vector<bool>& state) const;
+    void restore_state(const std::vector<bool>& state);
+    // the instance whose state the body currently holds
+    const FunctionNode* loaded = nullptr;
+
+    // cycles, delay and step order of the body, computed on first use after attach_nodes
+    const GraphAnalysis& analysis() const;
+    bool is_cyclic() const;
+    // whether one pass over order settles the body, its nodes can form a loop even when it isn't cyclic
+    bool settles_in_one_pass() const;
+    int delay() const;
+    void sort_linear();
+
+    // Outputs of an acyclic body once the pins held these values long enough to settle. From the
+    // truth table when there are at most max_table_inputs pins, otherwise from an LRU memo of
+    // memo_entries input vectors, stepping the body on a miss.
+    const std::vector<bool>& settled_outputs(const std::vector<bool>& pins, size_t max_table_inputs, size_t memo_entries);
+    // ticks from a pin change to the outputs
+    int table_latency();
+
+private:
+    mutable GraphAnalysis analysis_val;
+    mutable bool analysis_valid = false;
+    // the nodes that are functions themselves, null for the others, so swapping state needs no casts
+    std::vector<FunctionNode*> functions;
+
+    // steps the body from the loaded state until the outputs settle and puts the state back
+    void settle(const std::vector<bool>& pins, std::vector<bool>& outputs);
+    // indexed by the pins as a binary number, pin 0 in the lowest bit
+    std::vector<std::vector<bool>> table;
+    // most recently used first
+    std::list<std::pair<std::vector<bool>, std::vector<bool>>> memo;
+    std::unordered_map<std::vector<bool>, std::list<std::pair<std::vector<bool>, std::vector<bool>>>::iterator> memo_index;
+};
+
+// Every definition used by the nodes, nested ones included, each after the definitions its body uses
+std::vector<const FunctionDefinition*> CollectFunctionDefinitions(const std::vector<Node*>& nodes);
+// the "definitions" table of a save
+json FunctionDefinitionsToJson(const std::vector<Node*>& nodes);
+
 class FunctionNode : public Node {
 public:
     
-    FunctionNode(std::vector<Node*> * container, Vector2 pos = {0, 0}) : Node(container, pos, {0, 0}, ColorBrightness(GRAY, -0.6f)), is_single_tick(false) {
+    FunctionNode(std::vector<Node*> * container, Vector2 pos = {0, 0}) : Node(container, pos, {0, 0}, ColorBrightness(GRAY, -0.6f)), definition(std::make_shared<FunctionDefinition>()), is_single_tick(false) {
         label = "Function";
     }
 
@@ -699,26 +931,39 @@ public:
 
     virtual bool show_node_editor();
 
-    std::vector<Node*> nodes;
-    
-    std::vector<Node*> input_targs;
-    std::vector<Node*> output_targs;
-     
+    std::shared_ptr<FunctionDefinition> definition;
+    // this instance's state of the body, laid out as described at FunctionDefinition::state_size
+    std::vector<bool> state;
+    // Set for functions inside another function's body. Their node is shared by every instance of
+    // the outer function and table lookups keep history outside the state, so they always step.
+    bool in_body = false;
 
     virtual json to_JSON() const override;
 
     virtual void load_extra_JSON(const json& nodeJson) override;
 
+    virtual void save_extra_binary(BinaryWriter& writer) const override;
+    virtual void load_extra_binary(BinaryReader& reader) override;
+
+    // takes ownership of loaded nodes as the body of a new definition
+    void set_nodes(const std::vector<Node*>& new_nodes);
+
+    // makes this an instance of the definition in its initial state, adding the pins it needs
+    void set_definition(const std::shared_ptr<FunctionDefinition>& new_definition);
+
     virtual void draw() override;
 
     virtual void pretick() override;
 
     virtual void tick() override;
 
-    virtual bool is_cyclic() const override;
-    virtual int delay() const override;
+    virtual bool is_cyclic() const override { return definition->is_cyclic(); }
+    virtual int delay() const override { return definition->delay(); }
 
-    void sort_linear();
+    void sort_linear() { definition->sort_linear(); }
+
+    bool single_tick() const { return is_single_tick; }
+    void set_single_tick(bool single_tick);
     
     virtual std::string get_type() const override { return"FunctionNode"; }
 
@@ -726,9 +971,17 @@ protected:
     virtual void recompute_size() override;
     
 private:
-    std::optional<bool> is_cyclic_val;
     bool is_single_tick;
     std::string delay_str;
+    // whether the last pretick stepped the body, and whether anything in it changed when it did
+    bool stepped = false;
+    bool body_changed = true;
+
+    void pretick_table();
+    std::vector<bool> table_pins;
+    // the looked up outputs of the last table_latency ticks, a ring starting at table_head
+    std::vector<std::vector<bool>> table_history;
+    size_t table_head = 0;
 };
 
 class NodeFactory {
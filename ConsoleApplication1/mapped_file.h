@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Read only view of a whole file mapped into memory, so loaders can parse it in place and the
+// OS pages it in on demand instead of it being copied through stream buffers.
+// Lives in its own file because windows.h and raylib.h can't be included in the same translation unit.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // false if the file can't be opened or mapped, empty files can't be mapped either
+    bool open(const std::string& filePath);
+    void close();
+
+    const uint8_t* data() const { return view; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* view = nullptr;
+    size_t length = 0;
+};
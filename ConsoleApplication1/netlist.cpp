@@ -0,0 +1,623 @@
+#include "netlist.h"
+
+#include "main_game.h"
+#include "graph_analysis.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <map>
+#include <functional>
+
+static bool eval_gate(GateOp op, const SignalStore& state, const uint32_t* in, const uint32_t* in_end, uint32_t self)
+{
+    switch (op)
+    {
+    case GateOp::CONST_0:
+        return false;
+    case GateOp::AND:
+        if (in == in_end) return false;
+        for (; in != in_end; ++in) if (!state.get(*in)) return false;
+        return true;
+    case GateOp::NAND:
+        if (in == in_end) return true;
+        for (; in != in_end; ++in) if (!state.get(*in)) return true;
+        return false;
+    case GateOp::OR:
+        for (; in != in_end; ++in) if (state.get(*in)) return true;
+        return false;
+    case GateOp::NOR:
+        for (; in != in_end; ++in) if (state.get(*in)) return false;
+        return true;
+    case GateOp::XOR:
+    {
+        bool retval = false;
+        for (; in != in_end; ++in) retval ^= state.get(*in);
+        return retval;
+    }
+    case GateOp::XNOR:
+    {
+        bool retval = true;
+        for (; in != in_end; ++in) retval ^= state.get(*in);
+        return retval;
+    }
+    case GateOp::BUFFER:
+        return in != in_end && state.get(*in);
+    case GateOp::NOT:
+        return !(in != in_end && state.get(*in));
+    case GateOp::INPUT:
+    case GateOp::OPAQUE:
+        return state.get(self);
+    }
+    return false;
+}
+
+void Netlist::clear()
+{
+    ops.clear();
+    fanin_begin.clear();
+    fanin.clear();
+    fanout_begin.clear();
+    fanout.clear();
+    op_host.clear();
+    op_pin.clear();
+    signals.resize(0);
+    bindings.clear();
+    input_ops.clear();
+    opaque_nodes.clear();
+    opaque_ops.clear();
+    opaque_reads.clear();
+    probes.clear();
+    flat_instances.clear();
+    level_order.clear();
+    loops.clear();
+    oscillations = 0;
+    active.clear();
+    queued.clear();
+    changed.clear();
+}
+
+uint32_t Netlist::add_op(GateOp op, Node* host, uint32_t pin)
+{
+    ops.push_back(op);
+    op_host.push_back(host);
+    op_pin.push_back(pin);
+    if (op == GateOp::INPUT) input_ops.push_back(uint32_t(ops.size() - 1));
+    if (op == GateOp::OPAQUE) opaque_ops.push_back(uint32_t(ops.size() - 1));
+    return uint32_t(ops.size() - 1);
+}
+
+// The top level or the body of one inlined FunctionNode instance. Body nodes are shared by every
+// instance of a definition, so their connectors only map to signals within a scope.
+struct NetlistScope {
+    size_t parent;
+    const FunctionNode* instance; // the instance in the parent scope, null for the top level
+    std::unordered_map<const Output_connector*, uint32_t> signal_of;
+    std::unordered_map<const Node*, size_t> children; // inlined functions and the scopes of their bodies
+};
+
+void Netlist::compile(const std::vector<Node*>& nodes, bool flatten_functions)
+{
+    static const std::unordered_map<std::string, GateOp> lowered_types = {
+        {"GateAND", GateOp::AND},
+        {"GateOR", GateOp::OR},
+        {"GateNAND", GateOp::NAND},
+        {"GateNOR", GateOp::NOR},
+        {"GateXOR", GateOp::XOR},
+        {"GateXNOR", GateOp::XNOR},
+        {"GateBUFFER", GateOp::BUFFER},
+        {"GateNOT", GateOp::NOT},
+        {"PushButton", GateOp::INPUT},
+        {"ToggleButton", GateOp::INPUT},
+        {"StaticToggleButton", GateOp::INPUT},
+    };
+    // nodes without outputs that only display what they read
+    static const std::unordered_set<std::string> sink_types = { "LightBulb", "SevenSegmentDisplay" };
+
+    auto lower = [](const Node* node) {
+        auto it = lowered_types.find(node->get_type());
+        return it != lowered_types.end() ? it->second : GateOp::OPAQUE;
+    };
+
+    clear();
+
+    // A function is inlined if everything in its body can be, nested functions included. Single
+    // tick functions step their whole body within one tick, which unit delay ops can't express, so
+    // they stay opaque and keep their own pretick/tick.
+    std::unordered_map<const FunctionDefinition*, bool> flattenable_bodies;
+    std::function<bool(const FunctionNode*)> flattenable = [&](const FunctionNode* function) {
+        if (function->single_tick()) return false;
+        auto it = flattenable_bodies.find(function->definition.get());
+        if (it != flattenable_bodies.end()) return it->second;
+
+        bool retval = true;
+        for (Node* node : function->definition->nodes) {
+            if (const FunctionNode* inner = dynamic_cast<const FunctionNode*>(node)) retval = retval && flattenable(inner);
+            else if (lower(node) == GateOp::OPAQUE && !sink_types.count(node->get_type()) && !dynamic_cast<Bus*>(node)) retval = false;
+        }
+        flattenable_bodies[function->definition.get()] = retval;
+        return retval;
+    };
+
+    // every node of every scope, in the order their ops are created
+    std::vector<NetlistScope> scopes(1, NetlistScope{ 0, nullptr });
+    std::vector<std::pair<size_t, Node*>> flat;
+    std::function<void(size_t, const std::vector<Node*>&)> expand = [&](size_t scope, const std::vector<Node*>& network) {
+        for (Node* node : network) {
+            flat.push_back({ scope, node });
+            FunctionNode* function = dynamic_cast<FunctionNode*>(node);
+            if (!function || !flatten_functions || !flattenable(function)) continue;
+
+            size_t child = scopes.size();
+            scopes.push_back(NetlistScope{ scope, function });
+            scopes[scope].children[function] = child;
+            expand(child, function->definition->nodes);
+        }
+    };
+    expand(0, nodes);
+
+    // nodes that get no ops of their own, a pin of a body reads the instance's input
+    auto inlined = [&](size_t scope, const Node* node) {
+        return (scope != 0 && node->isInput()) || scopes[scope].children.count(node);
+    };
+
+    std::vector<std::pair<size_t, std::vector<Bus*>>> buses;
+    std::map<std::pair<size_t, std::string>, size_t> bus_idx;
+
+    add_op(GateOp::CONST_0, nullptr, 0);
+
+    // first pass gives every output connector a signal
+    for (auto& [scope, node] : flat) {
+        if (Bus* bus = dynamic_cast<Bus*>(node)) {
+            auto it = bus_idx.find({ scope, bus->label });
+            if (it == bus_idx.end()) {
+                bus_idx[{ scope, bus->label }] = buses.size();
+                buses.push_back({ scope, { bus } });
+            }
+            else buses[it->second].second.push_back(bus);
+            continue;
+        }
+        if (sink_types.count(node->get_type()) || inlined(scope, node)) continue;
+
+        GateOp op = lower(node);
+        if (op == GateOp::OPAQUE) opaque_nodes.push_back(node);
+
+        for (size_t pin = 0; pin < node->outputs.size(); pin++) {
+            uint32_t sig = add_op(op, node, uint32_t(pin));
+            // a static button inside a body holds the value from the instance state, the editor doesn't own it
+            if (op == GateOp::INPUT && scope != 0) input_ops.pop_back();
+            scopes[scope].signal_of[&node->outputs[pin]] = sig;
+            if (scope == 0) bindings.push_back({ &node->outputs[pin], sig });
+        }
+    }
+
+    // buses sharing a label within a scope are wired-OR lines, every member output aliases the line signal
+    std::vector<size_t> bus_width;
+    for (auto& [scope, members] : buses) {
+        size_t width = 0;
+        for (Bus* bus : members) width = std::max(width, std::max(bus->inputs.size(), bus->outputs.size()));
+
+        bus_width.push_back(width);
+        for (size_t bit = 0; bit < width; bit++) {
+            uint32_t line = add_op(GateOp::OR, members[0], uint32_t(bit));
+            for (Bus* bus : members) {
+                if (bit < bus->outputs.size()) {
+                    scopes[scope].signal_of[&bus->outputs[bit]] = line;
+                    if (scope == 0) bindings.push_back({ &bus->outputs[bit], line });
+                }
+            }
+        }
+    }
+
+    // The outputs of an inlined function alias the signal driving them inside the body, and the
+    // pins inside the body alias what the instance's inputs read. An output wired straight to a pin
+    // got its value a tick late from FunctionNode::tick, it gets a buffer to keep that delay.
+    std::vector<uint32_t> buffer_sources;
+    std::function<uint32_t(size_t, const Output_connector*)> resolve = [&](size_t scope, const Output_connector* conn) -> uint32_t {
+        auto it = scopes[scope].signal_of.find(conn);
+        if (it != scopes[scope].signal_of.end()) return it->second;
+
+        // a loop of plain wires reads 0
+        scopes[scope].signal_of[conn] = 0;
+        uint32_t sig = 0;
+        const Node* host = conn->host;
+        auto child = scopes[scope].children.find(host);
+        if (child != scopes[scope].children.end()) {
+            const FunctionDefinition& body = *static_cast<const FunctionNode*>(host)->definition;
+            size_t pin = conn->index;
+            for (Node* targ : body.output_targs) {
+                if (pin >= targ->inputs.size()) {
+                    pin -= targ->inputs.size();
+                    continue;
+                }
+                const Output_connector* target = targ->inputs[pin].target;
+                if (target && target->host->isInput()) {
+                    sig = add_op(GateOp::BUFFER, const_cast<Node*>(host), uint32_t(conn->index));
+                    scopes[scope].signal_of[conn] = sig;
+                    size_t buffer = buffer_sources.size();
+                    buffer_sources.push_back(0);
+                    buffer_sources[buffer] = resolve(child->second, target);
+                }
+                else if (target) sig = resolve(child->second, target);
+                break;
+            }
+        }
+        else if (scope != 0 && host->isInput()) {
+            const FunctionNode* instance = scopes[scope].instance;
+            size_t pin = 0;
+            for (Node* targ : instance->definition->input_targs) {
+                if (targ == host) break;
+                pin += targ->outputs.size();
+            }
+            pin += conn->index;
+            if (pin < instance->inputs.size() && instance->inputs[pin].target)
+                sig = resolve(scopes[scope].parent, instance->inputs[pin].target);
+        }
+        scopes[scope].signal_of[conn] = sig;
+        return sig;
+    };
+    auto signal = [&](size_t scope, const Input_connector& in) -> uint32_t {
+        return in.target ? resolve(scope, in.target) : 0;
+    };
+
+    // every buffer exists before the fanin is emitted in op order
+    for (auto& [scope, node] : flat) {
+        if (!scopes[scope].children.count(node)) continue;
+        for (Output_connector& output : node->outputs) {
+            uint32_t sig = resolve(scope, &output);
+            if (scope == 0) bindings.push_back({ &output, sig });
+        }
+    }
+
+    // second pass emits the fanin in op order
+    fanin_begin.reserve(ops.size() + 1);
+    fanin_begin.push_back(0); // CONST_0
+    for (auto& [scope, node] : flat) {
+        if (sink_types.count(node->get_type())) {
+            if (scope != 0) continue;
+            for (size_t pin = 0; pin < node->inputs.size(); pin++) {
+                probes.push_back({ node, uint32_t(pin), signal(scope, node->inputs[pin]) });
+            }
+            continue;
+        }
+        if (dynamic_cast<Bus*>(node) || inlined(scope, node)) continue;
+
+        bool is_opaque = lower(node) == GateOp::OPAQUE;
+        for (size_t pin = 0; pin < node->outputs.size(); pin++) {
+            fanin_begin.push_back(uint32_t(fanin.size()));
+            if (is_opaque) continue;
+            for (Input_connector* in : node->connected_inputs(pin)) {
+                fanin.push_back(signal(scope, *in));
+            }
+        }
+        if (is_opaque) {
+            for (Input_connector& in : node->inputs) {
+                if (in.target && scopes[scope].signal_of.count(in.target)) {
+                    opaque_reads.push_back({ in.target, signal(scope, in) });
+                    in.target->host->has_changed = true;
+                }
+            }
+        }
+    }
+    for (size_t b = 0; b < buses.size(); b++) {
+        for (size_t bit = 0; bit < bus_width[b]; bit++) {
+            fanin_begin.push_back(uint32_t(fanin.size()));
+            for (Bus* bus : buses[b].second) {
+                if (bit < bus->inputs.size()) fanin.push_back(signal(buses[b].first, bus->inputs[bit]));
+            }
+        }
+    }
+    for (uint32_t source : buffer_sources) {
+        fanin_begin.push_back(uint32_t(fanin.size()));
+        fanin.push_back(source);
+    }
+    fanin_begin.push_back(uint32_t(fanin.size()));
+
+    // the signal behind every bit of a top level instance's state, in FunctionDefinition::store_state order
+    std::function<void(size_t, const FunctionDefinition&, std::vector<uint32_t>&)> state_layout = [&](size_t scope, const FunctionDefinition& body, std::vector<uint32_t>& state_signals) {
+        for (Node* node : body.nodes) {
+            state_signals.push_back(no_signal);
+            for (Output_connector& output : node->outputs) {
+                state_signals.push_back(resolve(scope, &output));
+            }
+            auto child = scopes[scope].children.find(node);
+            if (child != scopes[scope].children.end())
+                state_layout(child->second, *static_cast<FunctionNode*>(node)->definition, state_signals);
+        }
+    };
+    for (Node* node : nodes) {
+        auto child = scopes[0].children.find(node);
+        if (child == scopes[0].children.end()) continue;
+
+        FlatInstance flat_instance{ static_cast<FunctionNode*>(node) };
+        state_layout(child->second, *flat_instance.instance->definition, flat_instance.state_signals);
+        if (flat_instance.state_signals.size() == flat_instance.instance->state.size())
+            flat_instances.push_back(std::move(flat_instance));
+    }
+
+    // invert the fanin into a fanout list for the event driven scheduler
+    fanout_begin.assign(ops.size() + 1, 0);
+    for (uint32_t sig : fanin) fanout_begin[sig + 1]++;
+    for (size_t i = 0; i < ops.size(); i++) fanout_begin[i + 1] += fanout_begin[i];
+    fanout.resize(fanin.size());
+    {
+        std::vector<uint32_t> fill(fanout_begin.begin(), fanout_begin.end() - 1);
+        for (uint32_t op = 0; op < ops.size(); op++) {
+            for (uint32_t i = fanin_begin[op]; i < fanin_begin[op + 1]; i++) {
+                fanout[fill[fanin[i]]++] = op;
+            }
+        }
+    }
+
+    levelize();
+
+    // everything is evaluated once so the first event driven tick settles the compiled state
+    queued.assign(ops.size(), 1);
+    active.resize(ops.size());
+    for (uint32_t op = 0; op < ops.size(); op++) active[op] = op;
+
+    signals.resize(ops.size());
+    for (const FlatInstance& flat_instance : flat_instances) {
+        for (size_t i = 0; i < flat_instance.state_signals.size(); i++) {
+            uint32_t sig = flat_instance.state_signals[i];
+            if (sig != no_signal && sig != 0 && flat_instance.instance->state[i]) signals.set(sig, true);
+        }
+    }
+    for (auto& [conn, sig] : bindings) {
+        if (conn->state) signals.set(sig, true);
+    }
+    signals.copy_to_next();
+}
+
+void Netlist::levelize()
+{
+    // Components come drivers first, so the gates outside of loops end up after everything they
+    // read and every loop is one contiguous span of level_order.
+    StrongComponents components;
+    components.find(fanin_begin, fanin);
+
+    level_order.clear();
+    loops.clear();
+    oscillations = 0;
+    for (uint32_t c = 0; c < components.count(); c++) {
+        uint32_t begin = uint32_t(level_order.size());
+        for (uint32_t i = components.member_begin[c]; i < components.member_begin[c + 1]; i++) {
+            uint32_t member = components.members[i];
+            if (ops[member] != GateOp::CONST_0 && ops[member] != GateOp::INPUT && ops[member] != GateOp::OPAQUE)
+                level_order.push_back(member);
+        }
+        // opaque ops keep their value for the whole pretick, a loop through one settles in a pass
+        if (components.loops[c] && level_order.size() > begin) loops.push_back({ begin, uint32_t(level_order.size()) });
+    }
+}
+
+bool Netlist::eval_in_place(uint32_t op)
+{
+    const uint32_t* in = fanin.data() + fanin_begin[op];
+    const uint32_t* in_end = fanin.data() + fanin_begin[op + 1];
+    bool value = eval_gate(ops[op], signals, in, in_end, op);
+    if (value == signals.get(op)) return false;
+    signals.set(op, value);
+    return true;
+}
+
+void Netlist::settle_loop(uint32_t begin, uint32_t end)
+{
+    bool changed_any = false;
+    for (uint32_t i = begin; i < end; i++) changed_any |= eval_in_place(level_order[i]);
+    if (!changed_any) return;
+
+    // the first pass is what a loop that never settles falls back to
+    loop_scratch.clear();
+    for (uint32_t i = begin; i < end; i++) loop_scratch.push_back(signals.get(level_order[i]));
+
+    for (int iteration = 1; iteration < loop_iteration_limit; iteration++) {
+        changed_any = false;
+        for (uint32_t i = begin; i < end; i++) changed_any |= eval_in_place(level_order[i]);
+        if (!changed_any) return;
+    }
+
+    for (uint32_t i = begin; i < end; i++) signals.set(level_order[i], loop_scratch[i - begin] != 0);
+    oscillations++;
+}
+
+void Netlist::activate_fanout(uint32_t sig)
+{
+    for (uint32_t i = fanout_begin[sig]; i < fanout_begin[sig + 1]; i++) {
+        uint32_t op = fanout[i];
+        if (!queued[op]) {
+            queued[op] = 1;
+            active.push_back(op);
+        }
+    }
+}
+
+void Netlist::set_input(size_t input, bool value)
+{
+    uint32_t op = input_ops[input];
+    if (value != signals.get(op)) {
+        signals.set(op, value);
+        activate_fanout(op);
+    }
+}
+
+void Netlist::sync_from_editor()
+{
+    for (size_t i = 0; i < input_ops.size(); i++) {
+        set_input(i, op_host[input_ops[i]]->outputs[op_pin[input_ops[i]]].state);
+    }
+}
+
+void Netlist::sync_to_editor() const
+{
+    for (auto& [conn, sig] : bindings) {
+        if (ops[sig] == GateOp::INPUT) continue;
+        conn->state = signals.get(sig);
+    }
+    sync_flat_state(signals.words());
+}
+
+void Netlist::sync_flat_state(const uint64_t* words) const
+{
+    for (const FlatInstance& flat_instance : flat_instances) {
+        FunctionNode* instance = flat_instance.instance;
+        for (size_t i = 0; i < flat_instance.state_signals.size(); i++) {
+            uint32_t sig = flat_instance.state_signals[i];
+            instance->state[i] = sig == no_signal || ((words[sig >> 6] >> (sig & 63)) & 1);
+        }
+        // the body connectors hold an older state of this instance now
+        if (instance->definition->loaded == instance) instance->definition->loaded = nullptr;
+    }
+}
+
+void Netlist::read_editor_inputs(std::vector<uint8_t>& values) const
+{
+    values.resize(input_ops.size());
+    for (size_t i = 0; i < input_ops.size(); i++) {
+        values[i] = op_host[input_ops[i]]->outputs[op_pin[input_ops[i]]].state;
+    }
+}
+
+void Netlist::sync_to_editor(const std::vector<uint64_t>& words) const
+{
+    for (auto& [conn, sig] : bindings) {
+        if (ops[sig] == GateOp::INPUT) continue;
+        conn->state = (words[sig >> 6] >> (sig & 63)) & 1;
+    }
+    sync_flat_state(words.data());
+}
+
+void Netlist::copy_state(std::vector<uint64_t>& words) const
+{
+    words.assign(signals.words(), signals.words() + signals.word_count());
+}
+
+void Netlist::eval_words(size_t first, size_t last)
+{
+    // every op drives the signal with its own index, so the next state is built a whole word at a time
+    const size_t count = ops.size();
+    uint64_t* next = signals.next_words();
+    for (size_t w = first; w < last; w++) {
+        uint64_t word = 0;
+        const size_t end = std::min(count, (w + 1) * 64);
+        for (size_t i = w * 64; i < end; i++) {
+            const uint32_t* in = fanin.data() + fanin_begin[i];
+            const uint32_t* in_end = fanin.data() + fanin_begin[i + 1];
+            if (eval_gate(ops[i], signals, in, in_end, uint32_t(i)))
+                word |= uint64_t(1) << (i & 63);
+        }
+        next[w] = word;
+    }
+}
+
+void Netlist::pretick_opaque()
+{
+    if (opaque_nodes.empty()) return;
+
+    for (auto& [conn, sig] : opaque_reads) {
+        if (conn->state != signals.get(sig)) {
+            conn->state = signals.get(sig);
+            conn->host->has_changed = true;
+        }
+    }
+    for (Node* node : opaque_nodes) {
+        node->pretick();
+    }
+}
+
+void Netlist::pretick()
+{
+    eval_words(0, signals.word_count());
+    pretick_opaque();
+}
+
+void Netlist::pretick_parallel(WorkStealingPool& pool)
+{
+    // chunks are whole words so no two threads ever write the same word of the next state
+    const size_t words = signals.word_count();
+    const size_t chunks = (words + parallel_chunk_words - 1) / parallel_chunk_words;
+    pool.run(chunks, [&](size_t chunk) {
+        eval_words(chunk * parallel_chunk_words, std::min(words, (chunk + 1) * parallel_chunk_words));
+    });
+
+    // opaque nodes touch the editor graph, they stay on this thread
+    pretick_opaque();
+}
+
+void Netlist::tick()
+{
+    for (Node* node : opaque_nodes) {
+        node->tick();
+    }
+    for (uint32_t op : opaque_ops) {
+        signals.set_next(op, op_host[op]->outputs[op_pin[op]].state);
+    }
+    signals.flip();
+
+    // the full schedule evaluated everything, nothing is pending for the event driven one
+    for (uint32_t op : active) queued[op] = 0;
+    active.clear();
+}
+
+void Netlist::pretick_events()
+{
+    changed.clear();
+    for (uint32_t op : active) {
+        queued[op] = 0;
+        const uint32_t* in = fanin.data() + fanin_begin[op];
+        const uint32_t* in_end = fanin.data() + fanin_begin[op + 1];
+        if (eval_gate(ops[op], signals, in, in_end, op) != signals.get(op))
+            changed.push_back(op);
+    }
+    active.clear();
+
+    pretick_opaque();
+}
+
+void Netlist::tick_events()
+{
+    for (Node* node : opaque_nodes) {
+        node->tick();
+    }
+    for (uint32_t op : opaque_ops) {
+        if (op_host[op]->outputs[op_pin[op]].state != signals.get(op))
+            changed.push_back(op);
+    }
+
+    for (uint32_t sig : changed) {
+        signals.set(sig, !signals.get(sig));
+        activate_fanout(sig);
+    }
+    changed.clear();
+}
+
+void Netlist::pretick_levelized()
+{
+    size_t next_loop = 0;
+    for (uint32_t i = 0; i < level_order.size();) {
+        if (next_loop < loops.size() && loops[next_loop].first == i) {
+            settle_loop(loops[next_loop].first, loops[next_loop].second);
+            i = loops[next_loop].second;
+            next_loop++;
+            continue;
+        }
+        eval_in_place(level_order[i]);
+        i++;
+    }
+    pretick_opaque();
+}
+
+void Netlist::tick_levelized()
+{
+    for (Node* node : opaque_nodes) {
+        node->tick();
+    }
+    for (uint32_t op : opaque_ops) {
+        signals.set(op, op_host[op]->outputs[op_pin[op]].state);
+    }
+
+    // nothing is pending for the event driven schedule, the gates were evaluated in place
+    for (uint32_t op : active) queued[op] = 0;
+    active.clear();
+}
@@ -0,0 +1,159 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include "signal_store.h"
+#include "thread_pool.h"
+
+struct Node;
+struct Output_connector;
+class FunctionNode;
+
+// One opcode per driven signal. The signal driven by op i has id i, signal 0 is the constant 0
+// that every unconnected input reads.
+enum class GateOp : uint8_t {
+    CONST_0,
+    AND,
+    OR,
+    NAND,
+    NOR,
+    XOR,
+    XNOR,
+    BUFFER,
+    NOT,
+    INPUT,  // value is owned by the editor (buttons) and copied in before each pretick
+    OPAQUE, // output of a node that could not be lowered, stepped through its own pretick/tick
+};
+
+// An input of a display node (LightBulb, SevenSegmentDisplay) and the signal it reads
+struct NetlistProbe {
+    Node* host;
+    uint32_t pin;
+    uint32_t signal;
+};
+
+// A FunctionNode whose body was inlined into the netlist and the signal behind every bit of its
+// state, in the layout of FunctionDefinition::store_state. has_changed bits have no signal.
+struct FlatInstance {
+    FunctionNode* instance;
+    std::vector<uint32_t> state_signals;
+};
+
+// Flat lowering of an editor graph. Gates read their inputs from one packed signal store
+// through a CSR fanin list, so a tick is one linear pass and a buffer flip instead of virtual
+// calls that chase pointers into nodes scattered over the heap.
+//
+// With flatten_functions the bodies of FunctionNodes are inlined recursively, one copy of the
+// body's gates per instance, so nested functions cost no more per tick than the same gates drawn
+// at the top level. The pins of a body alias the signals wired to the instance, its outputs alias
+// the signals driving them inside. Single tick functions, and functions holding nodes that can't
+// be lowered, stay opaque.
+class Netlist {
+public:
+    // Rebuilds the netlist from the given nodes, taking the current connector and function states as the initial state.
+    void compile(const std::vector<Node*>& nodes, bool flatten_functions = true);
+
+    void clear();
+
+    // Copies the state of the editor owned inputs into the netlist
+    void sync_from_editor();
+    // Writes the netlist state back into the editor connectors and the states of inlined functions,
+    // only needed when something is drawn or saved. Input connectors are left to the editor, a
+    // click since the last tick hasn't reached the netlist yet.
+    void sync_to_editor() const;
+
+    // Split up versions of the syncs for when another thread steps the netlist. These only read
+    // what compile built, so the editor side can call them while the state is being stepped.
+    void read_editor_inputs(std::vector<uint8_t>& values) const;      // one value per input op
+    void sync_to_editor(const std::vector<uint64_t>& words) const;    // input connectors are left to the editor
+    // these belong to the thread stepping the netlist
+    void set_input(size_t input, bool value);
+    void copy_state(std::vector<uint64_t>& words) const;
+
+    // Evaluates every op
+    void pretick();
+    void tick();
+
+    // Same as pretick, with the gates split over the pool. tick is a buffer flip and stays on the caller.
+    void pretick_parallel(WorkStealingPool& pool);
+    // words of 64 ops handed to a thread at a time, 4096 ops keep a chunk's fanin and state reads in cache
+    static constexpr size_t parallel_chunk_words = 64;
+
+    // Evaluates only the ops whose inputs changed in the last tick, same unit delay semantics as pretick/tick
+    void pretick_events();
+    void tick_events();
+
+    // Zero delay evaluation. The ops are partitioned into strongly connected components and
+    // evaluated in their topological order, each reading what its drivers computed in the same
+    // tick, so combinational logic settles within one tick. Acyclic ops are evaluated once, every
+    // feedback loop is iterated until it stops changing. A loop still changing after
+    // loop_iteration_limit passes keeps its first pass, so an oscillator steps once per tick.
+    // Opaque nodes keep their unit delay.
+    void pretick_levelized();
+    void tick_levelized();
+
+    size_t signal_count() const { return ops.size(); }
+    size_t opaque_count() const { return opaque_nodes.size(); }
+    size_t active_count() const { return active.size(); }
+    size_t flat_instance_count() const { return flat_instances.size(); }
+    // feedback loops of the levelized order, and how often one failed to settle since compiling
+    size_t loop_count() const { return loops.size(); }
+    size_t oscillation_count() const { return oscillations; }
+
+    // the current state packed 64 signals to a word, and the editor connectors the top level signals mirror
+    const uint64_t* state_words() const { return signals.words(); }
+    const std::vector<std::pair<Output_connector*, uint32_t>>& editor_bindings() const { return bindings; }
+    const std::vector<FlatInstance>& flattened_instances() const { return flat_instances; }
+
+    static constexpr uint32_t no_signal = UINT32_MAX;
+    static constexpr int loop_iteration_limit = 64;
+
+private:
+    friend class BatchSimulator;
+
+    uint32_t add_op(GateOp op, Node* host, uint32_t pin);
+    void activate_fanout(uint32_t sig);
+    void eval_words(size_t first, size_t last);
+    void pretick_opaque();
+    void sync_flat_state(const uint64_t* words) const;
+    void levelize();
+    // evaluates an op reading the values of this tick, returns whether it changed
+    bool eval_in_place(uint32_t op);
+    void settle_loop(uint32_t begin, uint32_t end);
+
+    std::vector<GateOp> ops;
+    std::vector<uint32_t> fanin_begin;  // fanin of op i is fanin[fanin_begin[i] .. fanin_begin[i + 1]]
+    std::vector<uint32_t> fanin;
+    std::vector<uint32_t> fanout_begin; // ops reading signal i are fanout[fanout_begin[i] .. fanout_begin[i + 1]]
+    std::vector<uint32_t> fanout;
+
+    std::vector<Node*> op_host;
+    std::vector<uint32_t> op_pin;
+
+    SignalStore signals;
+
+    // event driven scheduling
+    std::vector<uint32_t> active;   // ops to evaluate in the next pretick
+    std::vector<uint8_t> queued;    // whether an op is already in active
+    std::vector<uint32_t> changed;  // signals that flip in the next tick
+
+    // zero delay scheduling, the gates in the order they are evaluated, inputs and opaque ops excluded
+    std::vector<uint32_t> level_order;
+    // the spans of level_order that form a feedback loop, [first, second)
+    std::vector<std::pair<uint32_t, uint32_t>> loops;
+    std::vector<uint8_t> loop_scratch;
+    size_t oscillations = 0;
+
+    // every editor connector and the signal it mirrors
+    std::vector<std::pair<Output_connector*, uint32_t>> bindings;
+
+    std::vector<uint32_t> input_ops;
+    std::vector<NetlistProbe> probes;
+    // top level functions whose bodies were inlined
+    std::vector<FlatInstance> flat_instances;
+
+    std::vector<Node*> opaque_nodes;
+    std::vector<uint32_t> opaque_ops;
+    // signals read by opaque nodes, these are pushed into the editor before the opaque nodes are preticked
+    std::vector<std::pair<Output_connector*, uint32_t>> opaque_reads;
+};
@@ -0,0 +1,27 @@
+#include "process_memory.h"
+
+#ifdef _WIN32
+#pragma comment(lib, "psapi.lib")  // GetProcessMemoryInfo
+#include <Windows.h>
+#include <Psapi.h>
+
+size_t peak_memory_bytes()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+}
+#else
+#include <sys/resource.h>
+
+size_t peak_memory_bytes()
+{
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024;  // kilobytes on linux
+#endif
+}
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+#include <cstddef>
+
+// Largest resident set of this process so far in bytes, 0 if the platform doesn't report it.
+// Lives in its own file because windows.h and raylib.h can't be included in the same translation unit.
+size_t peak_memory_bytes();
@@ -0,0 +1,150 @@
+#include "profiler.h"
+
+#include "main_game.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void ProfileCounters::add(const ProfileCounters& other)
+{
+    pretick_calls += other.pretick_calls;
+    tick_calls += other.tick_calls;
+    changes += other.changes;
+    ns += other.ns;
+    self_ns += other.self_ns;
+}
+
+void Profiler::add_time(ProfileCounters& counters, uint64_t start, uint64_t outer_child_ns)
+{
+    uint64_t elapsed = now_ns() - start;
+    counters.ns += elapsed;
+    counters.self_ns += elapsed - std::min(elapsed, child_ns);
+    max_ns = std::max(max_ns, counters.ns);
+    // the step counts as nested time of the one around it
+    child_ns = outer_child_ns + elapsed;
+}
+
+void Profiler::pretick(Node* node)
+{
+    uint64_t outer_child_ns = child_ns;
+    child_ns = 0;
+    uint64_t start = now_ns();
+    node->pretick();
+    // looked up after the step, a FunctionNode adds its body to the map meanwhile
+    ProfileCounters& counters = entries[node];
+    counters.pretick_calls++;
+    add_time(counters, start, outer_child_ns);
+}
+
+void Profiler::tick(Node* node)
+{
+    uint64_t outer_child_ns = child_ns;
+    child_ns = 0;
+    uint64_t start = now_ns();
+    node->tick();
+    ProfileCounters& counters = entries[node];
+    counters.tick_calls++;
+    if (node->has_changed) counters.changes++;
+    add_time(counters, start, outer_child_ns);
+}
+
+void Profiler::clear()
+{
+    entries.clear();
+    max_ns = 0;
+    child_ns = 0;
+}
+
+const ProfileCounters* Profiler::find(const Node* node) const
+{
+    auto it = entries.find(node);
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+float Profiler::heat(const Node* node) const
+{
+    const ProfileCounters* counters = find(node);
+    if (!counters || max_ns == 0) return 0;
+    return float(double(counters->ns) / double(max_ns));
+}
+
+std::map<std::string, ProfileCounters> Profiler::by_type() const
+{
+    std::map<std::string, ProfileCounters> types;
+    for (auto& [node, counters] : entries) {
+        ProfileCounters exclusive = counters;
+        exclusive.ns = counters.self_ns;
+        types[node->get_type()].add(exclusive);
+    }
+    return types;
+}
+
+static json counters_to_json(const ProfileCounters& counters)
+{
+    return {
+        {"pretick_calls", counters.pretick_calls},
+        {"tick_calls", counters.tick_calls},
+        {"changes", counters.changes},
+        {"ns", counters.ns},
+        {"self_ns", counters.self_ns}
+    };
+}
+
+bool Profiler::save(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Unable to open " << path << "\n";
+        return false;
+    }
+
+    // most expensive first
+    std::vector<std::pair<const Node*, ProfileCounters>> nodes(entries.begin(), entries.end());
+    std::sort(nodes.begin(), nodes.end(), [](const auto& a, const auto& b) { return a.second.ns > b.second.ns; });
+    std::map<std::string, ProfileCounters> types = by_type();
+
+    if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) {
+        json jNodes = json::array();
+        for (auto& [node, counters] : nodes) {
+            json jNode = counters_to_json(counters);
+            jNode["label"] = node->label;
+            jNode["type"] = node->get_type();
+            jNode["pos.x"] = node->pos.x;
+            jNode["pos.y"] = node->pos.y;
+            jNodes.push_back(jNode);
+        }
+        json jTypes = json::object();
+        for (auto& [type, counters] : types) {
+            jTypes[type] = counters_to_json(counters);
+        }
+        file << json{ {"nodes", jNodes}, {"types", jTypes} }.dump(4);
+    }
+    else {
+        // labels are free text, they are quoted with quotes doubled
+        auto quoted = [](const std::string& text) {
+            std::string out = "\"";
+            for (char c : text) {
+                if (c == '"') out += '"';
+                out += c;
+            }
+            return out + "\"";
+        };
+        file << "kind,label,type,pretick_calls,tick_calls,changes,ns,self_ns\n";
+        for (auto& [node, counters] : nodes) {
+            file << "node," << quoted(node->label) << "," << node->get_type() << "," << counters.pretick_calls << ","
+                 << counters.tick_calls << "," << counters.changes << "," << counters.ns << "," << counters.self_ns << "\n";
+        }
+        for (auto& [type, counters] : types) {
+            file << "type,," << type << "," << counters.pretick_calls << "," << counters.tick_calls << ","
+                 << counters.changes << "," << counters.ns << "," << counters.self_ns << "\n";
+        }
+    }
+    return bool(file);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <unordered_map>
+#include <map>
+#include <string>
+#include <cstdint>
+
+struct Node;
+
+struct ProfileCounters {
+    uint64_t pretick_calls = 0;
+    uint64_t tick_calls = 0;
+    // ticks that changed an output
+    uint64_t changes = 0;
+    uint64_t ns = 0;
+    // ns without the steps of other nodes inside this one, the body of a FunctionNode
+    uint64_t self_ns = 0;
+
+    void add(const ProfileCounters& other);
+};
+
+// Times the node steps of the editor graph: the GRAPH pass of Game and the body passes of
+// FunctionNodes, which the compiled modes also use for functions they can't lower. The passes
+// check enabled once and step through pretick/tick here, a disabled profiler costs that branch.
+//
+// A FunctionNode's time includes its body, its self time doesn't. Body nodes are shared by every
+// instance of their definition, so their counters cover all of them.
+class Profiler {
+public:
+    bool enabled = false;
+
+    void pretick(Node* node);
+    void tick(Node* node);
+
+    // called when a node is deleted, the counters are keyed by the node
+    void forget(const Node* node) { if (!entries.empty()) entries.erase(node); }
+    void clear();
+
+    const ProfileCounters* find(const Node* node) const;
+    // the node's time relative to the most expensive node, 0 to 1
+    float heat(const Node* node) const;
+    // the counters summed per type, ns is the self time so a body isn't counted again in its function
+    std::map<std::string, ProfileCounters> by_type() const;
+
+    // Writes a row per node and per type. JSON for paths ending in .json, CSV otherwise. Returns
+    // false if the file can't be written.
+    bool save(const std::string& path) const;
+
+private:
+    void add_time(ProfileCounters& counters, uint64_t start, uint64_t outer_child_ns);
+
+    std::unordered_map<const Node*, ProfileCounters> entries;
+    uint64_t max_ns = 0;
+    // time of the steps nested in the one in progress so far
+    uint64_t child_ns = 0;
+};
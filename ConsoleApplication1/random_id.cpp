@@ -1,11 +1,23 @@
 #include "random_id.h"
+
+#ifdef _WIN32
 #pragma comment(lib, "rpcrt4.lib")  // UuidCreate - Minimum supported OS Win 2000
 #include <Windows.h>
 
 
-uid_t generate_id() {
+connector_id_t generate_id() {
     UUID uuid;
     UuidCreate(&uuid);
 
     return uuid.Data1;
-}
\ No newline at end of file
+}
+#else
+#include <random>
+
+connector_id_t generate_id() {
+    static std::mt19937 rng{ std::random_device{}() };
+
+    // same 32 bits of randomness as the first field of a UUID on windows
+    return connector_id_t(rng());
+}
+#endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 
-typedef unsigned long uid_t;
+// uid_t would clash with the POSIX user id type
+typedef unsigned long connector_id_t;
 
-uid_t generate_id();
\ No newline at end of file
+connector_id_t generate_id();
\ No newline at end of file
@@ -0,0 +1,493 @@
+#include "sax_loader.h"
+#include "main_game.h"
+#include "vector_tools.h"
+
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+// Builds a json value out of the events of one subtree
+class Capture {
+public:
+    bool active() const { return !stack.empty(); }
+
+    // starts a container, at target if this is the root of the capture
+    void start(bool array, json* target = nullptr)
+    {
+        if (!target) {
+            value(array ? json::array() : json::object());
+            json& parent = *stack.back();
+            target = parent.is_array() ? &parent.back() : &parent[current_key];
+        }
+        else {
+            *target = array ? json::array() : json::object();
+        }
+        stack.push_back(target);
+    }
+
+    void end() { stack.pop_back(); }
+
+    void key(const std::string& key) { current_key = key; }
+
+    void value(json value)
+    {
+        json& parent = *stack.back();
+        if (parent.is_array()) parent.push_back(std::move(value));
+        else parent[current_key] = std::move(value);
+    }
+
+private:
+    std::vector<json*> stack;
+    std::string current_key;
+};
+
+enum class FrameKind {
+    ROOT,           // the save object
+    DEFINITIONS,    // the array of function definitions
+    DEFINITION,     // { "id": ..., "label": ..., "nodes": [ ... ] }
+    NETWORK,        // an array of nodes, the save's or a function body
+    NODE_WRAPPER,   // { "GateAND": { ... } }
+    NODE,
+    OUTPUTS,
+    OUTPUT_WRAPPER, // { "Output_connector": { ... } }
+    OUTPUT,
+    INPUTS,
+    INPUT_WRAPPER,  // { "Input_connector": { ... } }
+    INPUT,
+};
+
+struct Network {
+    std::vector<Node*>* container;
+    std::unordered_map<connector_id_t, Output_connector*> outputs_by_id;
+    std::vector<std::pair<Input_connector*, connector_id_t>> pending_inputs;
+    size_t duplicate_ids = 0;
+};
+
+// a node being read, it is not in its container until it is finished
+struct NodeState {
+    Node* node = nullptr;
+    json extra;
+    std::vector<std::pair<connector_id_t, bool>> outputs;
+    std::vector<connector_id_t> inputs;
+    // the body of a function node from a save that embeds it in every instance
+    std::shared_ptr<FunctionDefinition> body;
+};
+
+class SaveLoader : public nlohmann::json_sax<json> {
+public:
+    SaveLoader(std::vector<Node*>* nodes) : root_nodes(nodes), first_new(nodes->size()) {}
+
+    bool null() override { return on_value(nullptr); }
+    bool boolean(bool val) override { return on_value(val); }
+    bool number_integer(number_integer_t val) override { return on_value(val); }
+    bool number_unsigned(number_unsigned_t val) override { return on_value(val); }
+    bool number_float(number_float_t val, const string_t&) override { return on_value(val); }
+    bool string(string_t& val) override { return on_value(val); }
+    bool binary(binary_t&) override { return on_value(nullptr); }
+
+    bool key(string_t& val) override
+    {
+        if (skip_depth) return true;
+        if (capture.active()) capture.key(val);
+        else current_key = val;
+        return true;
+    }
+
+    bool start_object(std::size_t) override
+    {
+        if (skip_depth) {
+            skip_depth++;
+            return true;
+        }
+        if (capture.active()) {
+            capture.start(false);
+            return true;
+        }
+        if (frames.empty()) {
+            frames.push_back(FrameKind::ROOT);
+            return true;
+        }
+
+        switch (frames.back())
+        {
+        case FrameKind::ROOT:
+            if (current_key == "camera") {
+                capture.start(false, &camera_json);
+                return true;
+            }
+            break;
+        case FrameKind::DEFINITIONS:
+            frames.push_back(FrameKind::DEFINITION);
+            definition_id = 0;
+            definition_label.clear();
+            definition = nullptr;
+            return true;
+        case FrameKind::NETWORK:
+            frames.push_back(FrameKind::NODE_WRAPPER);
+            return true;
+        case FrameKind::NODE_WRAPPER:
+            return begin_node();
+        case FrameKind::NODE:
+            capture.start(false, &node_states[node_depth - 1].extra[current_key]);
+            return true;
+        case FrameKind::OUTPUTS:
+            frames.push_back(FrameKind::OUTPUT_WRAPPER);
+            return true;
+        case FrameKind::OUTPUT_WRAPPER:
+            if (current_key == "Output_connector") {
+                frames.push_back(FrameKind::OUTPUT);
+                connector_id = 0;
+                connector_state = false;
+                return true;
+            }
+            break;
+        case FrameKind::INPUTS:
+            frames.push_back(FrameKind::INPUT_WRAPPER);
+            return true;
+        case FrameKind::INPUT_WRAPPER:
+            if (current_key == "Input_connector") {
+                frames.push_back(FrameKind::INPUT);
+                connector_id = 0;
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+        skip_depth = 1;
+        return true;
+    }
+
+    bool end_object() override
+    {
+        if (skip_depth) {
+            skip_depth--;
+            return true;
+        }
+        if (capture.active()) {
+            capture.end();
+            return true;
+        }
+
+        switch (frames.back())
+        {
+        case FrameKind::DEFINITION:
+            finish_definition();
+            break;
+        case FrameKind::NODE:
+            finish_node();
+            break;
+        case FrameKind::OUTPUT:
+            node_states[node_depth - 1].outputs.push_back({ connector_id, connector_state });
+            break;
+        case FrameKind::INPUT:
+            node_states[node_depth - 1].inputs.push_back(connector_id);
+            break;
+        default:
+            break;
+        }
+        frames.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        if (skip_depth) {
+            skip_depth++;
+            return true;
+        }
+        if (capture.active()) {
+            capture.start(true);
+            return true;
+        }
+        if (frames.empty()) {
+            error = "a save has to be a JSON object";
+            return false;
+        }
+
+        if (frames.back() == FrameKind::ROOT && current_key == "nodes") {
+            frames.push_back(FrameKind::NETWORK);
+            networks.push_back({ root_nodes });
+            return true;
+        }
+        if (frames.back() == FrameKind::ROOT && current_key == "definitions") {
+            frames.push_back(FrameKind::DEFINITIONS);
+            return true;
+        }
+        if (frames.back() == FrameKind::DEFINITION && current_key == "nodes" && !definition) {
+            // a definition that is already alive is shared, its copy in the save is skipped
+            definition = definition_id ? FunctionDefinition::find(definition_id) : nullptr;
+            if (definition) {
+                definition_reused = true;
+                skip_depth = 1;
+                return true;
+            }
+            definition = FunctionDefinition::create(definition_id ? definition_id : generate_id());
+            definition_reused = false;
+            frames.push_back(FrameKind::NETWORK);
+            networks.push_back({ &definition->nodes });
+            return true;
+        }
+        if (frames.back() == FrameKind::NODE) {
+            NodeState& state = node_states[node_depth - 1];
+            FunctionNode* function = dynamic_cast<FunctionNode*>(state.node);
+            if (current_key == "outputs") {
+                frames.push_back(FrameKind::OUTPUTS);
+            }
+            else if (current_key == "inputs") {
+                frames.push_back(FrameKind::INPUTS);
+            }
+            else if (current_key == "nodes" && function && !state.body) {
+                // older saves embed the body, it streams straight into a definition of its own
+                state.body = FunctionDefinition::create();
+                frames.push_back(FrameKind::NETWORK);
+                networks.push_back({ &state.body->nodes });
+            }
+            else {
+                capture.start(true, &state.extra[current_key]);
+            }
+            return true;
+        }
+        skip_depth = 1;
+        return true;
+    }
+
+    bool end_array() override
+    {
+        if (skip_depth) {
+            skip_depth--;
+            return true;
+        }
+        if (capture.active()) {
+            capture.end();
+            return true;
+        }
+
+        if (frames.back() == FrameKind::NETWORK) {
+            Network& network = networks.back();
+            size_t dangling_ids = 0;
+            for (auto& [input, id] : network.pending_inputs) {
+                auto found = network.outputs_by_id.find(id);
+                if (found != network.outputs_by_id.end()) input->connect(found->second);
+                else dangling_ids++;
+            }
+            ReportConnectorIdProblems(network.duplicate_ids, dangling_ids);
+            networks.pop_back();
+        }
+        frames.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override
+    {
+        error = ex.what();
+        return false;
+    }
+
+    // deletes everything built so far
+    void abandon()
+    {
+        for (size_t i = 0; i < node_depth; i++) {
+            delete node_states[i].node;
+            node_states[i].body = nullptr;
+        }
+        node_depth = 0;
+        frames.clear();
+        networks.clear();
+        definition = nullptr;
+        definitions.clear();
+        for (size_t i = first_new; i < root_nodes->size(); i++) {
+            delete (*root_nodes)[i];
+        }
+        root_nodes->resize(first_new);
+    }
+
+    std::string error;
+    json camera_json;
+
+private:
+    bool on_value(json value)
+    {
+        if (skip_depth) return true;
+        if (capture.active()) {
+            capture.value(std::move(value));
+            return true;
+        }
+        if (frames.empty()) {
+            error = "a save has to be a JSON object";
+            return false;
+        }
+
+        try {
+            FrameKind frame = frames.back();
+            if (frame == FrameKind::NODE) {
+                NodeState& state = node_states[node_depth - 1];
+                Node* node = state.node;
+                if (current_key == "pos.x") node->pos.x = value.get<float>();
+                else if (current_key == "pos.y") node->pos.y = value.get<float>();
+                else if (current_key == "size.x") node->size.x = value.get<float>();
+                else if (current_key == "size.y") node->size.y = value.get<float>();
+                else if (current_key == "label") node->label = value.get<std::string>();
+                else state.extra[current_key] = std::move(value);
+            }
+            else if (frame == FrameKind::OUTPUT) {
+                if (current_key == "id") connector_id = value.get<connector_id_t>();
+                else if (current_key == "state") connector_state = value.get<bool>();
+            }
+            else if (frame == FrameKind::INPUT) {
+                if (current_key == "target") connector_id = value.get<connector_id_t>();
+            }
+            else if (frame == FrameKind::DEFINITION) {
+                if (current_key == "id") definition_id = value.get<connector_id_t>();
+                else if (current_key == "label") definition_label = value.get<std::string>();
+            }
+        }
+        catch (const json::exception& e) {
+            error = std::string("\"") + current_key + "\": " + e.what();
+            return false;
+        }
+        return true;
+    }
+
+    bool begin_node()
+    {
+        Node* node = NodeFactory::createNode(networks.back().container, current_key);
+        if (!node) {
+            error = "unknown node type " + current_key;
+            return false;
+        }
+
+        // states are reused so their vectors keep their capacity from node to node
+        if (node_depth == node_states.size()) node_states.emplace_back();
+        NodeState& state = node_states[node_depth++];
+        state.node = node;
+        state.extra = nullptr;
+        state.body = nullptr;
+        state.outputs.clear();
+        state.inputs.clear();
+
+        frames.push_back(FrameKind::NODE);
+        return true;
+    }
+
+    // the same steps as Node::load_JSON, with the connector lists read from the stream
+    void finish_node()
+    {
+        NodeState& state = node_states[--node_depth];
+        Node* node = state.node;
+        state.node = nullptr;
+
+        for (Input_connector& input : node->inputs) {
+            input.disconnect();
+        }
+        node->inputs.clear();
+        for (size_t i = 0; i < state.inputs.size(); i++) {
+            node->inputs.push_back(Input_connector(node, i, nullptr, state.inputs[i]));
+        }
+
+        for (Output_connector& output : node->outputs) {
+            output.disconnect_readers();
+        }
+        node->outputs.clear();
+        for (size_t i = 0; i < state.outputs.size(); i++) {
+            node->outputs.push_back(Output_connector(node, i, state.outputs[i].second, state.outputs[i].first));
+        }
+
+        // an embedded function body is already loaded, everything else gets its extras as json
+        FunctionNode* function = dynamic_cast<FunctionNode*>(node);
+        if (function && state.body) {
+            state.body->label = node->label;
+            state.body->attach_nodes();
+            function->set_definition(state.body);
+            state.body = nullptr;
+        }
+        else node->load_extra_JSON(state.extra);
+
+        Network& network = networks.back();
+        for (Output_connector& output : node->outputs) {
+            if (!network.outputs_by_id.emplace(output.id, &output).second) network.duplicate_ids++;
+        }
+        for (Input_connector& input : node->inputs) {
+            if (input.target_id) network.pending_inputs.push_back({ &input, input.target_id });
+        }
+        network.container->push_back(node);
+    }
+
+    void finish_definition()
+    {
+        if (!definition) definition = FunctionDefinition::create(definition_id ? definition_id : generate_id());
+        if (!definition_reused) {
+            definition->label = definition_label;
+            definition->attach_nodes();
+        }
+        // held until the end of the load, a definition no instance uses is dropped then
+        definitions.push_back(definition);
+        definition = nullptr;
+        definition_reused = false;
+    }
+
+    std::vector<Node*>* root_nodes;
+    size_t first_new;
+
+    std::vector<FrameKind> frames;
+    std::vector<Network> networks;
+    std::vector<NodeState> node_states;
+    size_t node_depth = 0;
+
+    // the entry of the definitions table being read
+    connector_id_t definition_id = 0;
+    std::string definition_label;
+    std::shared_ptr<FunctionDefinition> definition;
+    bool definition_reused = false;
+    std::vector<std::shared_ptr<FunctionDefinition>> definitions;
+
+    std::string current_key;
+    connector_id_t connector_id = 0;
+    bool connector_state = false;
+    Capture capture;
+    size_t skip_depth = 0;
+};
+
+}
+
+// parse is handed the loader and runs sax_parse over whichever input the caller has
+template <typename Parse>
+static bool load_save(Parse parse, std::vector<Node*>* nodes, Camera2D* camera)
+{
+    SaveLoader loader(nodes);
+    bool parsed = false;
+    try {
+        parsed = parse(loader);
+    }
+    catch (const json::exception& e) {
+        loader.error = e.what();
+    }
+
+    if (!parsed) {
+        loader.abandon();
+        std::cerr << "JSON parsing error: " << loader.error << '\n';
+        return false;
+    }
+
+    if (camera && loader.camera_json.is_object()) {
+        try {
+            *camera = loader.camera_json.get<Camera2D>();
+        }
+        catch (const json::exception& e) {
+            std::cerr << "JSON parsing error: " << e.what() << '\n';
+        }
+    }
+    return true;
+}
+
+bool NodeNetworkFromJsonStream(std::istream& stream, std::vector<Node*>* nodes, Camera2D* camera)
+{
+    return load_save([&](SaveLoader& loader) { return json::sax_parse(stream, &loader); }, nodes, camera);
+}
+
+bool NodeNetworkFromJsonBuffer(const uint8_t* data, size_t size, std::vector<Node*>* nodes, Camera2D* camera)
+{
+    const char* begin = reinterpret_cast<const char*>(data);
+    return load_save([&](SaveLoader& loader) { return json::sax_parse(begin, begin + size, &loader); }, nodes, camera);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <istream>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "raylib.h"
+
+struct Node;
+
+// Loads a JSON save straight from the stream through nlohmann's SAX interface. Nodes are built
+// as their tokens arrive, function definitions included, so no document tree of the save is ever
+// held in memory. Only the camera and type specific extras such as bus_values are collected into
+// small json values before they are applied. The definitions table has to come before the nodes
+// that use it, which the alphabetical key order of saved files guarantees.
+//
+// Appends the top level nodes to the container and sets the camera if one is given. Returns false
+// and removes the nodes it added if the stream is not a valid save.
+bool NodeNetworkFromJsonStream(std::istream& stream, std::vector<Node*>* nodes, Camera2D* camera = nullptr);
+// the same for a save that is already in memory, such as a MappedFile
+bool NodeNetworkFromJsonBuffer(const uint8_t* data, size_t size, std::vector<Node*>* nodes, Camera2D* camera = nullptr);
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Current and next state of every signal packed 64 to a word and indexed by a dense signal id.
+// Committing a tick is a flip of the two buffers instead of a compare-and-copy per connector.
+class SignalStore {
+public:
+    void resize(size_t count) {
+        signal_count = count;
+        current.assign((count + 63) / 64, 0);
+        next.assign((count + 63) / 64, 0);
+    }
+
+    size_t size() const { return signal_count; }
+    size_t word_count() const { return current.size(); }
+
+    bool get(uint32_t id) const { return (current[id >> 6] >> (id & 63)) & 1; }
+    bool get_next(uint32_t id) const { return (next[id >> 6] >> (id & 63)) & 1; }
+
+    void set(uint32_t id, bool value) { set_bit(current, id, value); }
+    void set_next(uint32_t id, bool value) { set_bit(next, id, value); }
+
+    const uint64_t* words() const { return current.data(); }
+    uint64_t* words() { return current.data(); }
+    const uint64_t* next_words() const { return next.data(); }
+    uint64_t* next_words() { return next.data(); }
+
+    // Makes the next state the current one
+    void flip() { current.swap(next); }
+
+    // Makes the next state equal to the current one, for when only part of the next state will be written
+    void copy_to_next() { next = current; }
+
+private:
+    static void set_bit(std::vector<uint64_t>& words, uint32_t id, bool value) {
+        uint64_t mask = uint64_t(1) << (id & 63);
+        if (value) words[id >> 6] |= mask;
+        else words[id >> 6] &= ~mask;
+    }
+
+    size_t signal_count = 0;
+    std::vector<uint64_t> current;
+    std::vector<uint64_t> next;
+};
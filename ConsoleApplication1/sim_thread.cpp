@@ -0,0 +1,137 @@
+#include "sim_thread.h"
+
+#include <chrono>
+#include <algorithm>
+
+void SimulationThread::start(Netlist& new_netlist, std::function<void()> new_step)
+{
+    stop();
+
+    netlist = &new_netlist;
+    step = std::move(new_step);
+    netlist->sync_from_editor();
+    netlist->read_editor_inputs(sent_inputs);
+
+    commands.clear();
+    has_commands = false;
+    snapshot_fresh = false;
+    snapshot_wanted = true;
+    ticks = 0;
+    reported_ticks = 0;
+
+    stopping = false;
+    worker = std::thread(&SimulationThread::loop, this);
+}
+
+void SimulationThread::stop()
+{
+    if (!worker.joinable()) return;
+    stopping = true;
+    worker.join();
+
+    // the netlist is back in the hands of the caller, commands still queued are not lost
+    apply_commands();
+}
+
+void SimulationThread::set_rate(float hz, bool unthrottled)
+{
+    target_hz.store(hz, std::memory_order_relaxed);
+    warp.store(unthrottled, std::memory_order_relaxed);
+}
+
+uint64_t SimulationThread::take_ticks()
+{
+    uint64_t total = ticks.load(std::memory_order_relaxed);
+    uint64_t retval = total - reported_ticks;
+    reported_ticks = total;
+    return retval;
+}
+
+void SimulationThread::sync_editor()
+{
+    netlist->read_editor_inputs(editor_inputs);
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        for (size_t i = 0; i < editor_inputs.size(); i++) {
+            if (editor_inputs[i] != sent_inputs[i]) {
+                commands.push_back({ uint32_t(i), editor_inputs[i] != 0 });
+                sent_inputs[i] = editor_inputs[i];
+            }
+        }
+        if (!commands.empty()) has_commands.store(true, std::memory_order_release);
+    }
+
+    bool fresh;
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        fresh = snapshot_fresh;
+        if (fresh) front.swap(shown);
+        snapshot_fresh = false;
+    }
+    if (fresh) netlist->sync_to_editor(shown);
+    snapshot_wanted.store(true, std::memory_order_relaxed);
+}
+
+void SimulationThread::apply_commands()
+{
+    std::lock_guard<std::mutex> lock(command_mutex);
+    for (auto& [input, value] : commands) {
+        netlist->set_input(input, value);
+    }
+    commands.clear();
+    has_commands.store(false, std::memory_order_relaxed);
+}
+
+void SimulationThread::publish()
+{
+    netlist->copy_state(back);
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        back.swap(front);
+        snapshot_fresh = true;
+    }
+    snapshot_wanted.store(false, std::memory_order_relaxed);
+}
+
+void SimulationThread::loop()
+{
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point last = clock::now();
+    double due = 0; // ticks owed at the target rate
+    double tick_cost = 0.001;
+    uint64_t last_batch = 1;
+
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (has_commands.load(std::memory_order_acquire)) apply_commands();
+        if (snapshot_wanted.load(std::memory_order_relaxed)) publish();
+
+        const double hz = target_hz.load(std::memory_order_relaxed);
+        const bool unthrottled = warp.load(std::memory_order_relaxed);
+
+        clock::time_point now = clock::now();
+        due += std::chrono::duration<double>(now - last).count() * hz;
+        due = std::min(due, hz * 5);
+        last = now;
+
+        if (!unthrottled && due < 1.0) {
+            double wait = hz > 0 ? (1.0 - due) / hz : 1.0;
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::min(wait, 0.001)));
+            continue;
+        }
+
+        // batches are sized from the measured tick cost to take about a millisecond, so queued edits
+        // and snapshots aren't held up and the clock is only read once per batch
+        uint64_t batch = uint64_t(0.001 / tick_cost);
+        batch = std::clamp<uint64_t>(batch, 1, last_batch * 2);
+        if (!unthrottled) batch = std::min(batch, uint64_t(due));
+        for (uint64_t b = 0; b < batch; b++) {
+            step();
+        }
+        tick_cost = std::max(std::chrono::duration<double>(clock::now() - now).count() / batch, 1e-9);
+        last_batch = batch;
+
+        ticks.fetch_add(batch, std::memory_order_relaxed);
+        due = unthrottled ? 0 : due - batch;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <utility>
+
+#include "netlist.h"
+
+// Steps a compiled netlist on its own thread so the tick rate isn't bound to the frame rate.
+// The editor never touches the netlist state while the thread runs: button edits are queued and
+// applied between ticks, and the renderer reads a snapshot the thread publishes once per frame.
+class SimulationThread {
+public:
+    ~SimulationThread() { stop(); }
+
+    // The netlist must not contain opaque ops, those step editor nodes. step runs one pretick/tick pair.
+    void start(Netlist& netlist, std::function<void()> step);
+    void stop();
+    bool running() const { return worker.joinable(); }
+
+    void set_rate(float hz, bool unthrottled);
+
+    // Called by the main thread once per frame, queues the inputs edited since the last call and
+    // writes the newest snapshot into the editor connectors.
+    void sync_editor();
+
+    // ticks run since the last call
+    uint64_t take_ticks();
+
+private:
+    void loop();
+    void apply_commands();
+    void publish();
+
+    Netlist* netlist = nullptr;
+    std::function<void()> step;
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+
+    std::atomic<float> target_hz{ 0 };
+    std::atomic<bool> warp{ false };
+    std::atomic<uint64_t> ticks{ 0 };
+    uint64_t reported_ticks = 0;
+
+    // input index and value, applied by the simulation thread between ticks
+    std::mutex command_mutex;
+    std::vector<std::pair<uint32_t, bool>> commands;
+    std::atomic<bool> has_commands{ false };
+    std::vector<uint8_t> sent_inputs;
+    std::vector<uint8_t> editor_inputs;
+
+    // the thread fills back and swaps it with front, the main thread swaps front with shown
+    std::mutex snapshot_mutex;
+    std::vector<uint64_t> back;
+    std::vector<uint64_t> front;
+    std::vector<uint64_t> shown;
+    bool snapshot_fresh = false;
+    std::atomic<bool> snapshot_wanted{ false };
+};
@@ -0,0 +1,108 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+static uint64_t pack(uint64_t front, uint64_t back) { return (front << 32) | back; }
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+{
+    thread_count = std::max<size_t>(thread_count, 1);
+    slices = std::make_unique<Slice[]>(thread_count);
+    for (size_t i = 1; i < thread_count; i++) {
+        workers.emplace_back(&WorkStealingPool::worker_loop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::run(size_t chunk_count, const std::function<void(size_t)>& new_job)
+{
+    if (chunk_count == 0) return;
+
+    const size_t threads = thread_count();
+    job.store(&new_job);
+    remaining.store(chunk_count);
+    for (size_t i = 0; i < threads; i++) {
+        uint64_t front = chunk_count * i / threads;
+        uint64_t back = chunk_count * (i + 1) / threads;
+        slices[i].bounds.store(pack(front, back));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    // barrier, chunks stolen by other threads may still be running
+    while (remaining.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+void WorkStealingPool::worker_loop(size_t id)
+{
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        work(id);
+    }
+}
+
+void WorkStealingPool::work(size_t id)
+{
+    size_t chunk;
+    while (pop(id, chunk) || steal(id, chunk)) {
+        (*job.load())(chunk);
+        remaining.fetch_sub(1);
+    }
+}
+
+bool WorkStealingPool::pop(size_t id, size_t& chunk)
+{
+    std::atomic<uint64_t>& bounds = slices[id].bounds;
+    uint64_t current = bounds.load();
+    while (true) {
+        uint64_t front = current >> 32, back = current & 0xffffffff;
+        if (front >= back) return false;
+        if (bounds.compare_exchange_weak(current, pack(front + 1, back))) {
+            chunk = size_t(front);
+            return true;
+        }
+    }
+}
+
+bool WorkStealingPool::steal(size_t thief, size_t& chunk)
+{
+    const size_t threads = thread_count();
+    for (size_t offset = 1; offset < threads; offset++) {
+        std::atomic<uint64_t>& bounds = slices[(thief + offset) % threads].bounds;
+        uint64_t current = bounds.load();
+        while (true) {
+            uint64_t front = current >> 32, back = current & 0xffffffff;
+            if (front >= back) break;
+            if (bounds.compare_exchange_weak(current, pack(front, back - 1))) {
+                chunk = size_t(back - 1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
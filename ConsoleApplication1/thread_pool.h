@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <cstdint>
+
+// Fixed set of threads that split a range of chunks between them. Every thread owns a slice of
+// the chunks and takes from its front; a thread that runs out steals from the back of another
+// slice, so uneven chunks still keep every thread busy until the end.
+class WorkStealingPool {
+public:
+    // thread_count includes the calling thread, which works on chunks during run()
+    explicit WorkStealingPool(size_t thread_count);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t thread_count() const { return workers.size() + 1; }
+
+    // Runs job(chunk) for every chunk in [0, chunk_count) and returns once all of them are done.
+    void run(size_t chunk_count, const std::function<void(size_t)>& job);
+
+private:
+    // front in the high half, back in the low half, so both ends can be moved with one CAS
+    struct alignas(64) Slice {
+        std::atomic<uint64_t> bounds{ 0 };
+    };
+
+    void worker_loop(size_t id);
+    void work(size_t id);
+    bool pop(size_t id, size_t& chunk);
+    bool steal(size_t thief, size_t& chunk);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Slice[]> slices;
+
+    std::atomic<const std::function<void(size_t)>*> job{ nullptr };
+    std::atomic<size_t> remaining{ 0 };
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    size_t generation = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,183 @@
+#include "vcd_recorder.h"
+
+#include <bit>
+#include <map>
+#include <memory>
+#include <charconv>
+#include <iostream>
+
+// identifiers are numbers in base 94 written with the printable characters
+static std::string id_code(size_t index)
+{
+    std::string code;
+    do {
+        code += char('!' + index % 94);
+        index /= 94;
+    } while (index);
+    return code;
+}
+
+// labels are free text, VCD names end at whitespace and viewers split them at dots and brackets
+static std::string sanitize(const std::string& label)
+{
+    std::string name = label.empty() ? "_" : label;
+    for (char& c : name) {
+        if (c <= ' ' || c > '~' || c == '.' || c == '[' || c == ']' || c == ':') c = '_';
+    }
+    return name;
+}
+
+namespace {
+struct VcdScope {
+    std::vector<const VcdSignal*> wires;
+    std::vector<std::pair<std::string, std::unique_ptr<VcdScope>>> children;
+    std::map<std::string, VcdScope*> child_index;
+
+    VcdScope& child(const std::string& name)
+    {
+        auto it = child_index.find(name);
+        if (it != child_index.end()) return *it->second;
+        children.push_back({ name, std::make_unique<VcdScope>() });
+        return *(child_index[name] = children.back().second.get());
+    }
+
+    void write(std::string& out, const std::vector<uint32_t>& code_index, const std::vector<std::string>& codes) const
+    {
+        for (const VcdSignal* wire : wires) {
+            out += "$var wire 1 " + codes[code_index[wire->bit]] + " " + sanitize(wire->name);
+            if (wire->index >= 0) out += " [" + std::to_string(wire->index) + "]";
+            out += " $end\n";
+        }
+        for (auto& [name, scope] : children) {
+            out += "$scope module " + sanitize(name) + " $end\n";
+            scope->write(out, code_index, codes);
+            out += "$upscope $end\n";
+        }
+    }
+};
+}
+
+bool VcdRecorder::open(const std::string& path, const std::vector<VcdSignal>& signals, size_t bit_count, const uint64_t* initial)
+{
+    close();
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Unable to open " << path << "\n";
+        return false;
+    }
+
+    size_t word_count = (bit_count + 63) / 64;
+    watched.assign(word_count, 0);
+    previous.assign(initial, initial + word_count);
+    code_index.assign(bit_count, UINT32_MAX);
+    codes.clear();
+
+    VcdScope root;
+    for (const VcdSignal& signal : signals) {
+        if (signal.bit >= bit_count) continue;
+        if (code_index[signal.bit] == UINT32_MAX) {
+            code_index[signal.bit] = uint32_t(codes.size());
+            codes.push_back(id_code(codes.size()));
+            watched[signal.bit >> 6] |= uint64_t(1) << (signal.bit & 63);
+        }
+        VcdScope* scope = &root;
+        for (const std::string& name : signal.scope) scope = &scope->child(name);
+        scope->wires.push_back(&signal);
+    }
+
+    buffer.clear();
+    buffer.reserve(chunk_bytes + 4096);
+    buffer += "$version LOGISIM $end\n";
+    buffer += "$comment one time unit per simulation tick $end\n";
+    buffer += "$timescale 1 ns $end\n";
+    root.write(buffer, code_index, codes);
+    buffer += "$enddefinitions $end\n";
+
+    buffer += "#0\n$dumpvars\n";
+    for (size_t w = 0; w < word_count; w++) {
+        previous[w] &= watched[w];
+        for (uint64_t bits = watched[w]; bits; bits &= bits - 1) {
+            int b = std::countr_zero(bits);
+            buffer += (previous[w] >> b) & 1 ? '1' : '0';
+            buffer += codes[code_index[w * 64 + b]];
+            buffer += '\n';
+        }
+    }
+    buffer += "$end\n";
+
+    tick = 0;
+    closing = false;
+    active = true;
+    writer = std::thread(&VcdRecorder::write_chunks, this);
+    return true;
+}
+
+void VcdRecorder::close()
+{
+    if (!active) return;
+    flush_buffer();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    chunk_ready.notify_one();
+    writer.join();
+    file.close();
+    buffer = std::string();
+    active = false;
+}
+
+void VcdRecorder::sample(const uint64_t* words)
+{
+    tick++;
+    bool stamped = false;
+    for (size_t w = 0; w < watched.size(); w++) {
+        uint64_t diff = (words[w] ^ previous[w]) & watched[w];
+        if (!diff) continue;
+        if (!stamped) {
+            // only ticks with changes get a timestamp
+            char digits[24];
+            buffer += '#';
+            buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), tick).ptr);
+            buffer += '\n';
+            stamped = true;
+        }
+        previous[w] ^= diff;
+        for (; diff; diff &= diff - 1) {
+            int b = std::countr_zero(diff);
+            buffer += (previous[w] >> b) & 1 ? '1' : '0';
+            buffer += codes[code_index[w * 64 + b]];
+            buffer += '\n';
+        }
+    }
+    if (buffer.size() >= chunk_bytes) flush_buffer();
+}
+
+void VcdRecorder::flush_buffer()
+{
+    if (buffer.empty()) return;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // changes are never dropped, a writer this far behind holds the simulation back instead
+        chunk_taken.wait(lock, [this] { return chunks.size() < max_chunks; });
+        chunks.push_back(std::move(buffer));
+    }
+    chunk_ready.notify_one();
+    buffer = std::string();
+    buffer.reserve(chunk_bytes + 4096);
+}
+
+void VcdRecorder::write_chunks()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        chunk_ready.wait(lock, [this] { return closing || !chunks.empty(); });
+        if (chunks.empty()) return;
+        std::string chunk = std::move(chunks.front());
+        chunks.pop_front();
+        lock.unlock();
+        chunk_taken.notify_one();
+        file.write(chunk.data(), std::streamsize(chunk.size()));
+        lock.lock();
+    }
+}
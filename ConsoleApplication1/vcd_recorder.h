@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+// a recorded wire, bit is its position in the sampled state words
+struct VcdSignal {
+    // the nested modules the wire is shown in, outermost first
+    std::vector<std::string> scope;
+    std::string name;
+    uint32_t bit;
+    // written as name [index] for the pins of nodes with several, viewers group them into a vector
+    int index = -1;
+};
+
+// Streams the value changes of a simulation to a VCD file, one time unit per tick. A tick is
+// sampled as state words packed like SignalStore and compared to the previous sample by XOR, so
+// only the bits that changed cost formatting. The text goes into a buffer that is handed to a
+// writer thread once it is full, the thread that steps the simulation never waits for the disk
+// unless the writer falls max_chunks buffers behind.
+class VcdRecorder {
+public:
+    ~VcdRecorder() { close(); }
+
+    // Writes the header and the initial values and starts the writer. bit_count is the size of the
+    // sampled state, wires naming the same bit share an identifier. Returns false if the file can't
+    // be opened.
+    bool open(const std::string& path, const std::vector<VcdSignal>& signals, size_t bit_count, const uint64_t* initial);
+    // writes what is buffered and stops the writer
+    void close();
+    bool recording() const { return active; }
+
+    // the state after a tick
+    void sample(const uint64_t* words);
+    uint64_t ticks() const { return tick; }
+
+    static constexpr size_t chunk_bytes = 1 << 20;
+    static constexpr size_t max_chunks = 64;
+
+private:
+    void flush_buffer();
+    void write_chunks();
+
+    bool active = false;
+    uint64_t tick = 0;
+    // the recorded bits, and their values in the last sample
+    std::vector<uint64_t> watched;
+    std::vector<uint64_t> previous;
+    // identifier of every recorded bit, an index into codes
+    std::vector<uint32_t> code_index;
+    std::vector<std::string> codes;
+    std::string buffer;
+
+    std::ofstream file;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable chunk_ready;
+    std::condition_variable chunk_taken;
+    std::deque<std::string> chunks;
+    bool closing = false;
+};
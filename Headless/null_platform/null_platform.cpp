@@ -0,0 +1,96 @@
+#include "raylib.h"
+#include "raymath.h"
+#include "raygui.h"
+
+#include <cmath>
+#include <algorithm>
+
+// there is no window, the screen is a fixed size so the editor code that lays out against it works
+int GetScreenWidth(void) { return 1280; }
+int GetScreenHeight(void) { return 720; }
+void BeginDrawing(void) {}
+void EndDrawing(void) {}
+void ClearBackground(Color) {}
+void BeginMode2D(Camera2D) {}
+void EndMode2D(void) {}
+
+// nothing is ever pressed
+bool IsKeyPressed(int) { return false; }
+bool IsKeyDown(int) { return false; }
+bool IsKeyReleased(int) { return false; }
+bool IsMouseButtonPressed(int) { return false; }
+bool IsMouseButtonDown(int) { return false; }
+bool IsMouseButtonReleased(int) { return false; }
+Vector2 GetMousePosition(void) { return { 0, 0 }; }
+Vector2 GetMouseDelta(void) { return { 0, 0 }; }
+float GetMouseWheelMove(void) { return 0; }
+
+void DrawLineEx(Vector2, Vector2, float, Color) {}
+void DrawLineBezier(Vector2, Vector2, float, Color) {}
+void DrawRectangleRec(Rectangle, Color) {}
+void DrawRectangleRounded(Rectangle, float, int, Color) {}
+void DrawRectangleRoundedLines(Rectangle, float, int, float, Color) {}
+void DrawTextureEx(Texture2D, Vector2, float, float, Color) {}
+Font GetFontDefault(void) { return {}; }
+void DrawText(const char*, int, int, int, Color) {}
+void DrawTextEx(Font, const char*, Vector2, float, float, Color) {}
+
+int GuiPanel(Rectangle, const char*) { return 0; }
+int GuiLine(Rectangle, const char*) { return 0; }
+int GuiLabel(Rectangle, const char*) { return 0; }
+int GuiButton(Rectangle, const char*) { return 0; }
+int GuiToggle(Rectangle, const char*, bool*) { return 0; }
+int GuiTextBox(Rectangle, char*, int, bool) { return 0; }
+
+// the editor panel of gui_ui.cpp, which isn't built here
+bool GuiUi() { return false; }
+
+// the math is the same as raylib's, positions are still converted when nodes are placed or saved
+Vector2 Vector2Add(Vector2 v1, Vector2 v2) { return { v1.x + v2.x, v1.y + v2.y }; }
+Vector2 Vector2Scale(Vector2 v, float scale) { return { v.x * scale, v.y * scale }; }
+
+Vector2 GetScreenToWorld2D(Vector2 position, Camera2D camera)
+{
+    float c = std::cos(-camera.rotation * 3.14159265f / 180.0f);
+    float s = std::sin(-camera.rotation * 3.14159265f / 180.0f);
+    float x = (position.x - camera.offset.x) / camera.zoom;
+    float y = (position.y - camera.offset.y) / camera.zoom;
+    return { x * c - y * s + camera.target.x, x * s + y * c + camera.target.y };
+}
+
+Vector2 GetWorldToScreen2D(Vector2 position, Camera2D camera)
+{
+    float c = std::cos(camera.rotation * 3.14159265f / 180.0f);
+    float s = std::sin(camera.rotation * 3.14159265f / 180.0f);
+    float x = position.x - camera.target.x;
+    float y = position.y - camera.target.y;
+    return { (x * c - y * s) * camera.zoom + camera.offset.x, (x * s + y * c) * camera.zoom + camera.offset.y };
+}
+
+bool CheckCollisionRecs(Rectangle rec1, Rectangle rec2)
+{
+    return rec1.x < rec2.x + rec2.width && rec1.x + rec1.width > rec2.x &&
+        rec1.y < rec2.y + rec2.height && rec1.y + rec1.height > rec2.y;
+}
+
+bool CheckCollisionPointRec(Vector2 point, Rectangle rec)
+{
+    return point.x >= rec.x && point.x < rec.x + rec.width && point.y >= rec.y && point.y < rec.y + rec.height;
+}
+
+Color Fade(Color color, float alpha)
+{
+    alpha = std::clamp(alpha, 0.0f, 1.0f);
+    return { color.r, color.g, color.b, (unsigned char)(255.0f * alpha) };
+}
+
+Color ColorBrightness(Color color, float factor)
+{
+    factor = std::clamp(factor, -1.0f, 1.0f);
+    auto channel = [factor](unsigned char v) {
+        float f = v;
+        f = factor < 0 ? f * (1 + factor) : f + (255 - f) * factor;
+        return (unsigned char)f;
+    };
+    return { channel(color.r), channel(color.g), channel(color.b), color.a };
+}
@@ -0,0 +1,10 @@
+#pragma once
+// the raygui controls of the node editors, they draw nothing and are never clicked, see raylib.h here
+#include "raylib.h"
+
+int GuiPanel(Rectangle bounds, const char* text);
+int GuiLine(Rectangle bounds, const char* text);
+int GuiLabel(Rectangle bounds, const char* text);
+int GuiButton(Rectangle bounds, const char* text);
+int GuiToggle(Rectangle bounds, const char* text, bool* active);
+int GuiTextBox(Rectangle bounds, char* text, int textSize, bool editMode);
@@ -0,0 +1,77 @@
+#pragma once
+// The part of raylib the simulation sources use, for the Headless and Benchmark targets. They are
+// built against this instead of raylib so they run on hosts without a display or raylib
+// installed. The value types match raylib's, the drawing calls do nothing and there is never any
+// input, see null_platform.cpp.
+
+typedef struct Vector2 { float x; float y; } Vector2;
+typedef struct Rectangle { float x; float y; float width; float height; } Rectangle;
+typedef struct Color { unsigned char r; unsigned char g; unsigned char b; unsigned char a; } Color;
+typedef struct Texture { unsigned int id; int width; int height; int mipmaps; int format; } Texture;
+typedef Texture Texture2D;
+typedef struct Font { int baseSize; int glyphCount; int glyphPadding; Texture2D texture; void* recs; void* glyphs; } Font;
+typedef struct Camera2D { Vector2 offset; Vector2 target; float rotation; float zoom; } Camera2D;
+
+#define YELLOW     Color{ 253, 249, 0, 255 }
+#define ORANGE     Color{ 255, 161, 0, 255 }
+#define RED        Color{ 230, 41, 55, 255 }
+#define GREEN      Color{ 0, 228, 48, 255 }
+#define DARKGREEN  Color{ 0, 117, 44, 255 }
+#define BLUE       Color{ 0, 121, 241, 255 }
+#define GRAY       Color{ 130, 130, 130, 255 }
+#define WHITE      Color{ 255, 255, 255, 255 }
+#define BLACK      Color{ 0, 0, 0, 255 }
+#define RAYWHITE   Color{ 245, 245, 245, 255 }
+
+typedef enum {
+    KEY_C = 67,
+    KEY_V = 86,
+    KEY_ENTER = 257,
+    KEY_DELETE = 261,
+    KEY_LEFT_SHIFT = 340,
+    KEY_LEFT_CONTROL = 341,
+} KeyboardKey;
+
+typedef enum {
+    MOUSE_BUTTON_LEFT = 0,
+    MOUSE_BUTTON_RIGHT = 1,
+} MouseButton;
+
+// window and frame
+int GetScreenWidth(void);
+int GetScreenHeight(void);
+void BeginDrawing(void);
+void EndDrawing(void);
+void ClearBackground(Color color);
+void BeginMode2D(Camera2D camera);
+void EndMode2D(void);
+
+// input
+bool IsKeyPressed(int key);
+bool IsKeyDown(int key);
+bool IsKeyReleased(int key);
+bool IsMouseButtonPressed(int button);
+bool IsMouseButtonDown(int button);
+bool IsMouseButtonReleased(int button);
+Vector2 GetMousePosition(void);
+Vector2 GetMouseDelta(void);
+float GetMouseWheelMove(void);
+
+// drawing
+void DrawLineEx(Vector2 startPos, Vector2 endPos, float thick, Color color);
+void DrawLineBezier(Vector2 startPos, Vector2 endPos, float thick, Color color);
+void DrawRectangleRec(Rectangle rec, Color color);
+void DrawRectangleRounded(Rectangle rec, float roundness, int segments, Color color);
+void DrawRectangleRoundedLines(Rectangle rec, float roundness, int segments, float lineThick, Color color);
+void DrawTextureEx(Texture2D texture, Vector2 position, float rotation, float scale, Color tint);
+Font GetFontDefault(void);
+void DrawText(const char* text, int posX, int posY, int fontSize, Color color);
+void DrawTextEx(Font font, const char* text, Vector2 position, float fontSize, float spacing, Color tint);
+
+// math
+Vector2 GetScreenToWorld2D(Vector2 position, Camera2D camera);
+Vector2 GetWorldToScreen2D(Vector2 position, Camera2D camera);
+bool CheckCollisionRecs(Rectangle rec1, Rectangle rec2);
+bool CheckCollisionPointRec(Vector2 point, Rectangle rec);
+Color Fade(Color color, float alpha);
+Color ColorBrightness(Color color, float factor);
@@ -0,0 +1,6 @@
+#pragma once
+// the raymath functions the simulation sources use, see raylib.h here
+#include "raylib.h"
+
+Vector2 Vector2Add(Vector2 v1, Vector2 v2);
+Vector2 Vector2Scale(Vector2 v, float scale);
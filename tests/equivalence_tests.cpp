@@ -0,0 +1,504 @@
+// Checks that the parts of the simulator that must agree do, on the benchmark circuits:
+//
+//   equivalence_tests modes      every simulation mode against GRAPH, tick by tick
+//   equivalence_tests loaders    the JSON and binary loaders against the circuit that was saved
+//   equivalence_tests analysis   GraphAnalysis against a plain recursive walk on random bodies
+//   equivalence_tests reload     Game::load over another circuit against loading into an empty editor
+//   equivalence_tests clipboard  GRAPH against COMPILED after copying a bus whose driver then goes away
+//   equivalence_tests single_tick  single tick functions against the value their body settles to
+//
+// Exits with 1 and prints what differs if any check fails.
+
+#include "main_game.h"
+#include "bench_circuits.h"
+#include "binary_save.h"
+#include "sax_loader.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (ok) return;
+    std::cerr << "FAIL: " << what << "\n";
+    failures++;
+}
+
+// small enough that every circuit runs in a fraction of a second in every mode
+static size_t test_size(const BenchCircuit& circuit)
+{
+    std::string name = circuit.name;
+    if (name == "nested_functions") return 2;
+    if (name == "counter" || name == "register_file") return 4;
+    return 8;
+}
+
+static void clear_circuit(Game& game)
+{
+    for (Node* node : game.nodes) delete node;
+    game.nodes.clear();
+    game.invalidate_netlist();
+}
+
+// the LightBulb inputs of the top level, one character per input
+static std::string output_bits(const std::vector<Node*>& nodes)
+{
+    std::string bits;
+    for (const Node* node : nodes) {
+        if (node->get_type() != "LightBulb") continue;
+        for (const Input_connector& in : node->inputs) bits += in.target && in.target->state ? '1' : '0';
+    }
+    return bits;
+}
+
+// Steps the circuit in game.nodes and returns the outputs after every tick. The inputs get new
+// values from a fixed sequence every period ticks, so runs with the same seed see the same stimulus.
+static std::vector<std::string> run_trace(Game& game, size_t ticks, size_t period, uint32_t seed)
+{
+    std::vector<Node*> inputs;
+    for (Node* node : game.nodes) {
+        if (node->isInput()) inputs.push_back(node);
+    }
+    std::mt19937 random(seed);
+    std::vector<std::string> trace;
+    for (size_t t = 0; t < ticks; t++) {
+        if (t % period == 0) {
+            for (Node* input : inputs) {
+                input->outputs[0].state = random() & 1;
+                input->has_changed = true;
+            }
+        }
+        game.pretick();
+        game.tick();
+        game.sync_netlist_to_editor();
+        trace.push_back(output_bits(game.nodes));
+    }
+    return trace;
+}
+
+struct ModeConfig {
+    const char* name;
+    SimulationMode mode;
+    bool flatten;
+    bool tables;
+};
+
+static std::vector<std::string> trace_circuit(Game& game, const BenchCircuit& circuit, const ModeConfig& config, size_t ticks, size_t period)
+{
+    CircuitBuilder builder{ &game.nodes };
+    circuit.build(builder, test_size(circuit));
+    game.sim_mode = config.mode;
+    game.flatten_functions = config.flatten;
+    game.function_tables = config.tables;
+    game.invalidate_netlist();
+    std::vector<std::string> trace = run_trace(game, ticks, period, 1);
+    clear_circuit(game);
+    return trace;
+}
+
+// index of the first tick the traces differ at, or -1
+static long first_difference(const std::vector<std::string>& a, const std::vector<std::string>& b, size_t period, bool settled_only)
+{
+    for (size_t t = 0; t < std::min(a.size(), b.size()); t++) {
+        if (settled_only && t % period != period - 1) continue;
+        if (a[t] != b[t]) return long(t);
+    }
+    return a.size() == b.size() ? -1 : long(std::min(a.size(), b.size()));
+}
+
+static void test_modes()
+{
+    Game& game = Game::getInstance();
+    game.sim_threads = 4;
+    game.parallel_min_signals = 0;
+
+    const ModeConfig graph = { "graph", GRAPH, true, false };
+    const ModeConfig configs[] = {
+        { "compiled", COMPILED, true, false },
+        { "event", EVENT, true, false },
+        { "parallel", PARALLEL, true, false },
+        { "compiled without flattening", COMPILED, false, false },
+        { "event without flattening", EVENT, false, false },
+    };
+    const size_t ticks = 400, period = 16;
+
+    for (const BenchCircuit& circuit : bench_circuits()) {
+        std::vector<std::string> expected = trace_circuit(game, circuit, graph, ticks, period);
+        for (const ModeConfig& config : configs) {
+            long t = first_difference(expected, trace_circuit(game, circuit, config, ticks, period), period, false);
+            check(t < 0, std::string(circuit.name) + ": " + config.name + " differs from graph at tick " + std::to_string(t));
+        }
+    }
+
+    // Levelized settles in zero time and tables skip the glitches of the body, so they only have
+    // to agree once the inputs held long enough, on the circuits without clocks.
+    const ModeConfig settled_configs[] = {
+        { "levelized", LEVELIZED, true, false },
+        { "graph with tables", GRAPH, true, true },
+        { "compiled with tables", COMPILED, false, true },
+    };
+    const size_t settle_period = 64;
+    for (const char* name : { "ripple_adder", "lookahead_adder", "nested_functions" }) {
+        const BenchCircuit& circuit = *find_bench_circuit(name);
+        std::vector<std::string> expected = trace_circuit(game, circuit, graph, ticks, settle_period);
+        for (const ModeConfig& config : settled_configs) {
+            long t = first_difference(expected, trace_circuit(game, circuit, config, ticks, settle_period), settle_period, true);
+            check(t < 0, std::string(name) + ": " + config.name + " differs from graph at settled tick " + std::to_string(t));
+        }
+    }
+}
+
+// type, label, output states, connections and function state of every node, nested bodies included
+static std::string describe(const std::vector<Node*>& nodes)
+{
+    std::unordered_map<const Output_connector*, std::string> names;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        for (Output_connector& output : nodes[i]->outputs) names[&output] = std::to_string(i) + "." + std::to_string(output.index);
+    }
+    std::ostringstream text;
+    for (const Node* node : nodes) {
+        text << node->get_type() << " \"" << node->label << "\" out ";
+        for (const Output_connector& output : node->outputs) text << output.state;
+        text << " in";
+        for (const Input_connector& in : node->inputs) text << " " << (in.target ? names[in.target] : "-");
+        if (const FunctionNode* function = dynamic_cast<const FunctionNode*>(node)) {
+            text << " state ";
+            for (bool bit : function->state) text << bit;
+            text << " body {\n" << describe(function->definition->nodes) << "}";
+        }
+        text << "\n";
+    }
+    return text.str();
+}
+
+static std::vector<uint8_t> read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void test_loaders()
+{
+    Game& game = Game::getInstance();
+    game.sim_mode = GRAPH;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+
+    for (const BenchCircuit& circuit : bench_circuits()) {
+        const std::string name = circuit.name;
+        CircuitBuilder builder{ &game.nodes };
+        circuit.build(builder, test_size(circuit));
+        game.invalidate_netlist();
+        // saved mid run, so the loaders have states to restore
+        run_trace(game, 37, 8, 2);
+
+        const std::string json_path = (dir / ("equivalence_" + name + ".json")).string();
+        const std::string binary_path = (dir / ("equivalence_" + name + ".lgsb")).string();
+        game.save(json_path);
+        game.save(binary_path);
+        const std::string saved = describe(game.nodes);
+        std::vector<std::string> expected = run_trace(game, 40, 8, 3);
+        clear_circuit(game);
+
+        auto compare = [&](const char* loader, std::vector<Node*>& loaded) {
+            check(describe(loaded) == saved, name + ": the " + loader + " loader doesn't restore the saved circuit");
+            game.nodes = loaded;
+            for (Node* node : game.nodes) node->move_to_container(&game.nodes);
+            game.invalidate_netlist();
+            check(run_trace(game, 40, 8, 3) == expected, name + ": the circuit from the " + loader + " loader simulates differently");
+            clear_circuit(game);
+        };
+
+        std::vector<Node*> loaded;
+        check(NodeNetworkFromFile(json_path, &loaded, nullptr), name + ": the mapped JSON load failed");
+        compare("mapped JSON", loaded);
+
+        loaded.clear();
+        std::ifstream stream(json_path, std::ios::binary);
+        check(NodeNetworkFromJsonStream(stream, &loaded), name + ": the streamed JSON load failed");
+        compare("streamed JSON", loaded);
+
+        loaded.clear();
+        check(NodeNetworkFromFile(binary_path, &loaded, nullptr), name + ": the binary load failed");
+        compare("binary", loaded);
+
+        // cut off files fail without leaving nodes behind
+        std::vector<uint8_t> binary = read_file(binary_path);
+        for (size_t cut : { size_t(3), size_t(10), binary.size() / 2, binary.size() - 1 }) {
+            std::vector<Node*> partial;
+            check(!load_binary_save(binary.data(), cut, nullptr, &partial) && partial.empty(),
+                name + ": a binary save cut at " + std::to_string(cut) + " bytes loads");
+        }
+        std::vector<uint8_t> text = read_file(json_path);
+        for (size_t cut : { text.size() / 3, text.size() / 2, text.size() - 3 }) {
+            std::vector<Node*> partial;
+            check(!NodeNetworkFromJsonBuffer(text.data(), cut, &partial) && partial.empty(),
+                name + ": a JSON save cut at " + std::to_string(cut) + " bytes loads");
+        }
+
+        std::filesystem::remove(json_path);
+        std::filesystem::remove(binary_path);
+    }
+}
+
+// Every circuit is loaded over every other one, the buses of the replaced circuit must not stay in
+// the groups of the editor. A load that fails leaves the circuit as it was.
+static void test_reload()
+{
+    Game& game = Game::getInstance();
+    game.sim_mode = GRAPH;
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+
+    std::vector<std::string> names, paths;
+    for (const BenchCircuit& circuit : bench_circuits()) {
+        names.push_back(circuit.name);
+        CircuitBuilder builder{ &game.nodes };
+        circuit.build(builder, test_size(circuit));
+        game.invalidate_netlist();
+        run_trace(game, 37, 8, 2);
+        paths.push_back((dir / ("reload_" + std::string(circuit.name) + ".json")).string());
+        game.save(paths.back());
+        clear_circuit(game);
+    }
+
+    // the fresh loads come first, a replaced circuit left behind would change them as well
+    std::vector<std::vector<std::string>> expected;
+    for (const std::string& path : paths) {
+        check(game.load(path), path + " doesn't load");
+        expected.push_back(run_trace(game, 60, 8, 3));
+        clear_circuit(game);
+    }
+
+    for (size_t second = 0; second < paths.size(); second++) {
+        for (size_t first = 0; first < paths.size(); first++) {
+            game.load(paths[first]);
+            run_trace(game, 20, 8, 4);
+            game.load(paths[second]);
+            check(run_trace(game, 60, 8, 3) == expected[second],
+                names[second] + " loaded over " + names[first] + " simulates differently from a fresh load");
+            clear_circuit(game);
+        }
+    }
+    const std::string missing = (dir / "reload_missing.json").string();
+    const std::string cut = (dir / "reload_cut.json").string();
+    std::filesystem::remove(missing);
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::vector<uint8_t> text = read_file(paths[i]);
+        std::ofstream(cut, std::ios::binary).write((const char*)text.data(), std::streamsize(text.size() / 2));
+
+        game.load(paths[i]);
+        const std::string before = describe(game.nodes);
+        check(!game.load(missing), "a missing file loads");
+        check(!game.load(cut), "a cut off file loads");
+        check(describe(game.nodes) == before, names[i] + " changed in a failed load");
+        check(run_trace(game, 60, 8, 3) == expected[i], names[i] + " simulates differently after a failed load");
+        clear_circuit(game);
+    }
+    std::filesystem::remove(cut);
+    for (const std::string& path : paths) std::filesystem::remove(path);
+}
+
+// A bus in the clipboard reads what its original read but belongs to no stepped container, it must
+// not drive the line of the original once that one stops driving it.
+static void test_clipboard()
+{
+    Game& game = Game::getInstance();
+    for (SimulationMode mode : { GRAPH, COMPILED }) {
+        CircuitBuilder builder{ &game.nodes };
+        Node* a = builder.add("ToggleButton");
+        Node* driver = builder.gate("Bus", { out(a) });
+        Node* reader = builder.gate("Bus", { nullptr });
+        builder.output("Y", out(reader));
+        a->outputs[0].state = true;
+        a->has_changed = true;
+
+        driver->is_selected = true;
+        game.copy_selected_nodes();
+        driver->is_selected = false;
+        driver->inputs[0].disconnect();
+
+        game.sim_mode = mode;
+        game.invalidate_netlist();
+        for (int t = 0; t < 8; t++) {
+            game.pretick();
+            game.tick();
+        }
+        game.sync_netlist_to_editor();
+        check(output_bits(game.nodes) == "0", std::string(mode == GRAPH ? "graph" : "compiled") + ": a copied bus drives the line");
+
+        clear_circuit(game);
+        for (Node* node : game.clipboard) delete node;
+        game.clipboard.clear();
+    }
+}
+
+// Random gates, buses and pins wired at random, acyclic when every input reads an earlier node.
+// The nodes belong to the returned body and not to any container.
+static std::vector<Node*> random_body(std::mt19937& random, size_t count, bool acyclic)
+{
+    static const char* types[] = { "GateAND", "GateOR", "GateNAND", "GateNOR", "GateXOR", "GateXNOR",
+        "GateBUFFER", "GateNOT", "ToggleButton", "LightBulb", "Bus" };
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < count; i++) {
+        Node* node = NodeFactory::createNode(&nodes, types[random() % std::size(types)]);
+        if (node->get_type() == "Bus") node->change_label(("BUS_" + std::to_string(random() % 3)).c_str());
+        for (size_t extra = random() % 3; extra > 0; extra--) node->add_input();
+        node->pos = { float(i * 10), float(random() % 1000) };
+        nodes.push_back(node);
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        // buses of one label share their values, any of them can close a loop
+        size_t limit = acyclic ? i : nodes.size();
+        if (acyclic && nodes[i]->get_type() == "Bus") continue;
+        for (Input_connector& in : nodes[i]->inputs) {
+            if (limit == 0 || random() % 8 == 0) continue;
+            Node* driver = nodes[random() % limit];
+            if (driver->outputs.empty() || (acyclic && driver->get_type() == "Bus")) continue;
+            in.connect(&driver->outputs[random() % driver->outputs.size()]);
+        }
+    }
+    return nodes;
+}
+
+static void test_analysis()
+{
+    std::mt19937 random(7);
+    for (int round = 0; round < 400; round++) {
+        bool acyclic = round % 2 == 0;
+        std::shared_ptr<FunctionDefinition> definition = FunctionDefinition::create();
+        definition->set_nodes(random_body(random, 10 + round % 40, acyclic));
+        const GraphAnalysis& analysis = definition->analysis();
+        const std::string where = "random body " + std::to_string(round);
+
+        // reference: a depth first walk from the outputs, and the longest path from the pins
+        enum Mark { unvisited, visiting, done };
+        std::unordered_map<const Output_connector*, Mark> marks;
+        std::unordered_map<const Output_connector*, int> longest;
+        bool cyclic = false;
+        std::function<int(Output_connector*)> walk = [&](Output_connector* conn) -> int {
+            Mark& mark = marks[conn];
+            if (mark == visiting) { cyclic = true; return 0; }
+            if (mark == done) return longest[conn];
+            if (conn->host->is_cyclic()) cyclic = true;
+            mark = visiting;
+            int path = 0;
+            if (!conn->host->isInput()) {
+                for (Input_connector* in : conn->host->connected_inputs(conn->index)) {
+                    if (in->target) path = std::max(path, walk(in->target));
+                }
+                path += conn->host->delay();
+            }
+            marks[conn] = done;
+            return longest[conn] = path;
+        };
+        int delay = 1;
+        for (Node* sink : definition->output_targs) {
+            for (Input_connector& in : sink->inputs) {
+                if (in.target) delay = std::max(delay, walk(in.target));
+            }
+        }
+
+        check(definition->is_cyclic() == cyclic, where + ": cyclic is " + std::to_string(definition->is_cyclic()));
+        if (!cyclic) check(definition->delay() == delay, where + ": delay " + std::to_string(definition->delay()) + ", expected " + std::to_string(delay));
+        if (acyclic) check(!cyclic && !analysis.node_loops, where + ": an acyclic body has a loop");
+
+        // Drivers are levelled below what they drive, except inside a loop. Without loops between
+        // the nodes every driver is stepped first.
+        std::unordered_map<const Node*, size_t> position;
+        for (size_t i = 0; i < analysis.linear_order.size(); i++) position[analysis.linear_order[i]] = i;
+        check(analysis.linear_order.size() == definition->nodes.size(), where + ": linear_order misses nodes");
+        for (Output_connector* conn : analysis.connectors) {
+            uint32_t c = analysis.index.at(conn);
+            for (Input_connector* in : conn->host->connected_inputs(conn->index)) {
+                if (!in->target || in->target->host == conn->host) continue;
+                uint32_t d = analysis.index.at(in->target);
+                if (analysis.components.component[c] == analysis.components.component[d]) continue;
+                check(analysis.components.component[d] < analysis.components.component[c] && analysis.level[d] < analysis.level[c],
+                    where + ": a driver is not numbered and levelled below what it drives");
+                if (!analysis.node_loops) {
+                    check(position[in->target->host] < position[conn->host], where + ": linear_order steps a node before its driver");
+                }
+            }
+        }
+    }
+}
+
+// A single tick function has to show what its body settles to after exactly one tick. Both bodies
+// read the pin a through a widened BUFFER w and return !a. In the first w has a second output at the
+// end of a chain of buffers, so it sits far above the NOT reading its first output. In the second
+// the NOT reads w and w reads the NOT, a loop between the nodes but not between their connectors.
+// It also returns !a through w, so whichever of the two steps first, one pass is not enough.
+static void test_single_tick()
+{
+    Game& game = Game::getInstance();
+    game.sim_mode = GRAPH;
+    for (bool node_loop : { false, true }) {
+        std::shared_ptr<FunctionDefinition> definition = FunctionDefinition::create();
+        {
+            std::vector<Node*> body;
+            CircuitBuilder inner{ &body };
+            Output_connector* a = inner.input("a");
+            if (!node_loop) {
+                Output_connector* chain = a;
+                for (int i = 0; i < 3; i++) chain = out(inner.gate("GateBUFFER", { chain }));
+                Node* inverter = inner.gate("GateNOT", { nullptr });
+                Node* w = inner.gate("GateBUFFER", { a, chain });
+                inverter->inputs[0].connect(out(w, 0));
+                inner.output("y", out(inverter));
+            }
+            else {
+                Node* inverter = inner.gate("GateNOT", { nullptr, a });
+                Node* w = inner.gate("GateBUFFER", { a, out(inverter, 1) });
+                inverter->inputs[0].connect(out(w, 0));
+                inner.output("y", out(inverter));
+                inner.output("z", out(w, 1));
+            }
+            definition->set_nodes(body);
+        }
+
+        CircuitBuilder builder{ &game.nodes };
+        Node* a = builder.add("ToggleButton");
+        FunctionNode* function = static_cast<FunctionNode*>(builder.add("FunctionNode"));
+        function->set_definition(definition);
+        function->set_single_tick(true);
+        function->inputs[0].connect(out(a));
+        for (size_t i = 0; i < function->outputs.size(); i++) builder.output("y", out(function, i));
+        game.invalidate_netlist();
+
+        const std::string where = node_loop ? "a body with a loop between its nodes" : "a body with a widened buffer";
+        for (bool value : { true, false, true }) {
+            a->outputs[0].state = value;
+            a->has_changed = true;
+            game.pretick();
+            game.tick();
+            check(output_bits(game.nodes) == std::string(function->outputs.size(), value ? '0' : '1'), where + " doesn't settle in one tick");
+        }
+        clear_circuit(game);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string test = argc > 1 ? argv[1] : "";
+    Game& game = Game::getInstance();
+    game.sim_on_thread = false;
+
+    if (test == "modes") test_modes();
+    else if (test == "loaders") test_loaders();
+    else if (test == "analysis") test_analysis();
+    else if (test == "reload") test_reload();
+    else if (test == "clipboard") test_clipboard();
+    else if (test == "single_tick") test_single_tick();
+    else {
+        std::cerr << "usage: equivalence_tests modes|loaders|analysis|reload|clipboard|single_tick\n";
+        return 2;
+    }
+    if (failures) std::cerr << failures << " checks failed\n";
+    return failures ? 1 : 0;
+}